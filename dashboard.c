@@ -0,0 +1,128 @@
+/*
+ * Grid of panels in one window, each drawn like a window of its own.
+ */
+
+#include "dashboard.h"
+#include "gfxctx.h"
+#include "util.h"
+
+#include <stdlib.h>
+#include <err.h>
+
+/*
+ * PANEL_WIDTH, PANEL_HEIGHT: Size of a panel before the window is
+ * resized or given a -geometry.
+ */
+#define PANEL_WIDTH	320
+#define PANEL_HEIGHT	240
+
+struct dashboard
+{
+	struct gfxwin *win;
+	int cols;
+	int rows;
+	struct gfxwin *panel[DASHBOARD_MAX_PANELS];	/* Row after row */
+	struct gfxseg seg[2 * DASHBOARD_MAX_PANELS];	/* Separators */
+};
+
+static void dashboard_draw(struct gfxwin *);
+static void layout(struct dashboard *);
+
+struct dashboard*
+dashboard_create(struct gfxctx *ctx, int cols, int rows)
+{
+	struct dashboard *dash;
+	int i;
+
+	if (cols < 1 || cols > DASHBOARD_MAX_PANELS || rows < 1 ||
+	    rows > DASHBOARD_MAX_PANELS || cols * rows > DASHBOARD_MAX_PANELS)
+		errx(1, "grid of %dx%d panels, at most %d", cols, rows,
+		    DASHBOARD_MAX_PANELS);
+
+	if ((dash = calloc(1, sizeof(struct dashboard))) == NULL)
+		err(1, "allocate dashboard");
+	dash->cols = cols;
+	dash->rows = rows;
+
+	dash->win = gfxwin_create(ctx, 0, 0, cols * PANEL_WIDTH,
+	    rows * PANEL_HEIGHT, "white", dash);
+	gfxwin_set_draw_callback(dash->win, dashboard_draw);
+	for (i = 0; i < cols * rows; i++)
+		dash->panel[i] = gfxwin_create_panel(dash->win, 0, 0, 1, 1,
+		    NULL);
+	dashboard_draw(dash->win);
+
+	return dash;
+}
+
+/*
+ * dashboard_panel: the i'th panel, counting row after row.
+ */
+struct gfxwin*
+dashboard_panel(struct dashboard *dash, int i)
+{
+	return dash->panel[i];
+}
+
+int
+dashboard_npanels(struct dashboard *dash)
+{
+	return dash->cols * dash->rows;
+}
+
+/*
+ * layout: share the window between the panels, a line between each,
+ * the last column and row taking what is left over.
+ */
+static void
+layout(struct dashboard *dash)
+{
+	int width, height, x, y, w, h, col, row;
+
+	width = gfxwin_width(dash->win);
+	height = gfxwin_height(dash->win);
+	for (row = 0; row < dash->rows; row++) {
+		y = row * height / dash->rows;
+		h = (row + 1) * height / dash->rows - y;
+		for (col = 0; col < dash->cols; col++) {
+			x = col * width / dash->cols;
+			w = (col + 1) * width / dash->cols - x;
+			gfxwin_move_panel(dash->panel[row * dash->cols + col],
+			    x + (col > 0), y + (row > 0),
+			    MAX(w - (col > 0), 1), MAX(h - (row > 0), 1));
+		}
+	}
+}
+
+/*
+ * dashboard_draw: lay out the panels for the size of the window and
+ * draw the lines between them. The panels draw themselves after this.
+ */
+static void
+dashboard_draw(struct gfxwin *win)
+{
+	struct dashboard *dash = gfxwin_data(win);
+	int width, height, i, n;
+
+	layout(dash);
+
+	width = gfxwin_width(win);
+	height = gfxwin_height(win);
+	gfxwin_clear(win, 0, 0, width, height);
+
+	n = 0;
+	for (i = 1; i < dash->cols; i++) {
+		dash->seg[n].x1 = dash->seg[n].x2 = i * width / dash->cols;
+		dash->seg[n].y1 = 0;
+		dash->seg[n].y2 = height - 1;
+		n++;
+	}
+	for (i = 1; i < dash->rows; i++) {
+		dash->seg[n].y1 = dash->seg[n].y2 = i * height / dash->rows;
+		dash->seg[n].x1 = 0;
+		dash->seg[n].x2 = width - 1;
+		n++;
+	}
+	if (n > 0)
+		gfxwin_draw_segments(win, GFXWIN_HL, dash->seg, n);
+}
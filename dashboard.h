@@ -0,0 +1,17 @@
+#ifndef DASHBOARD_H
+#define DASHBOARD_H
+
+struct gfxctx;
+struct gfxwin;
+struct dashboard;
+
+/*
+ * DASHBOARD_MAX_PANELS: Maximum number of panels in a grid.
+ */
+#define DASHBOARD_MAX_PANELS	256
+
+struct dashboard* dashboard_create(struct gfxctx *, int, int);
+struct gfxwin* dashboard_panel(struct dashboard *, int);
+int dashboard_npanels(struct dashboard *);
+
+#endif
@@ -0,0 +1,135 @@
+/*
+ * Series derived from the values of another as they are added: rate
+ * of a counter, delta, moving average and EWMA. Each value costs O(1),
+ * with only the window of a moving average kept.
+ */
+
+#include "derive.h"
+#include "graph.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <err.h>
+
+/*
+ * COUNTER_WRAP: Range of a 32-bit counter, which wraps much sooner
+ * than a 64-bit one.
+ */
+#define COUNTER_WRAP	4294967296.0
+
+static double counter_delta(double, double);
+
+/*
+ * derive_create: param is the window of a moving average, a whole
+ * number of values, or the weight of a new value in an EWMA, and
+ * otherwise unused.
+ */
+struct derive*
+derive_create(int kind, double param)
+{
+	struct derive *d;
+
+	if ((d = calloc(1, sizeof(struct derive))) == NULL)
+		err(1, "allocate derived series");
+	d->kind = kind;
+
+	switch (kind) {
+	case GRAPH_DERIVE_AVG:
+		if (!(param >= 1.0 && param <= GRAPH_MAX_WINDOW) ||
+		    param != floor(param))
+			errx(1, "moving average of %g values", param);
+		d->nwin = param;
+		if ((d->win = calloc(d->nwin, sizeof(double))) == NULL)
+			err(1, "allocate %zu values", d->nwin);
+		break;
+	case GRAPH_DERIVE_EWMA:
+		if (!(param > 0.0 && param <= 1.0))
+			errx(1, "EWMA weight %g not in (0, 1]", param);
+		d->alpha = param;
+		break;
+	}
+
+	return d;
+}
+
+/*
+ * derive_push: add value v at t nanoseconds and store the derived value
+ * to out. Returns false if there is none yet, such as for the first
+ * value of a rate or delta.
+ */
+bool
+derive_push(struct derive *d, int64_t t, double v, double *out)
+{
+	size_t i;
+
+	switch (d->kind) {
+	case GRAPH_DERIVE_RATE:
+		/*
+		 * Values read at once share the time, so the rate is
+		 * taken over all of them once the time moves on.
+		 */
+		if (d->have_last && t <= d->last_t)
+			return false;
+		if (d->have_last)
+			*out = counter_delta(d->last, v) /
+			    ((t - d->last_t) / 1e9);
+		break;
+	case GRAPH_DERIVE_DELTA:
+		if (d->have_last)
+			*out = v - d->last;
+		break;
+	case GRAPH_DERIVE_AVG:
+		if (d->len == d->nwin)
+			d->sum -= d->win[d->head];
+		else
+			d->len++;
+		d->win[d->head] = v;
+		d->sum += v;
+		d->head = (d->head + 1) % d->nwin;
+
+		/*
+		 * Sum again once per window so that rounding errors do
+		 * not pile up.
+		 */
+		if (d->head == 0) {
+			d->sum = 0.0;
+			for (i = 0; i < d->len; i++)
+				d->sum += d->win[i];
+		}
+		*out = d->sum / d->len;
+		return true;
+	case GRAPH_DERIVE_EWMA:
+		if (d->have_last)
+			d->last += d->alpha * (v - d->last);
+		else
+			d->last = v;
+		d->have_last = true;
+		*out = d->last;
+		return true;
+	}
+
+	if (!d->have_last) {
+		d->have_last = true;
+		d->last = v;
+		d->last_t = t;
+		return false;
+	}
+	d->last = v;
+	d->last_t = t;
+	return true;
+}
+
+/*
+ * counter_delta: increase of a counter from a to b. A counter going
+ * backwards from near the top of 32 bits has wrapped, otherwise it
+ * was reset and has counted b since.
+ */
+static double
+counter_delta(double a, double b)
+{
+	if (b >= a)
+		return b - a;
+	if (a < COUNTER_WRAP && a - b > COUNTER_WRAP / 2)
+		return b + COUNTER_WRAP - a;
+	return b;
+}
@@ -0,0 +1,29 @@
+#ifndef DERIVE_H
+#define DERIVE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * derive: state of a series derived from another, updated in O(1) per
+ * value.
+ */
+struct derive
+{
+	int kind;		/* GRAPH_DERIVE_* */
+	double alpha;		/* Of the EWMA */
+	bool have_last;
+	double last;		/* Previous value, or the EWMA */
+	int64_t last_t;
+	double *win;		/* Values in the moving average window */
+	size_t nwin;
+	size_t head;		/* Oldest value, next to be replaced */
+	size_t len;
+	double sum;		/* Running sum of the window */
+};
+
+struct derive* derive_create(int, double);
+bool derive_push(struct derive *, int64_t, double, double *);
+
+#endif
@@ -0,0 +1,82 @@
+/*
+ * feedgen - write a synthetic workload as xrtgraph input
+ *
+ * For benchmarking xrtgraph as a whole on a display or Xvfb, e.g.
+ * feedgen -fps 60 bursty | xrtgraph. Without -fps the rows are written
+ * as fast as the reader takes them.
+ */
+
+#include "synth.h"
+#include "util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <err.h>
+
+static void
+usage(const char *progname)
+{
+	fprintf(stderr, "Usage: %s [-fps <frames per second>] "
+	    "[-frames <n>] steady|bursty|ramp|multi\n", progname);
+	exit(1);
+}
+
+int
+main(int argc, char **argv)
+{
+	double row[SYNTH_MAX_SERIES];
+	struct synth synth;
+	struct timespec next;
+	uint64_t frame, nframes;
+	size_t i, j, n, nrows;
+	long fps, frame_ns;
+	int kind;
+
+	fps = 0;
+	nframes = UINT64_MAX;
+	kind = -1;
+	for (i = 1; i < (size_t) argc; i++) {
+		if (strcmp(argv[i], "-fps") == 0 && i + 1 < (size_t) argc)
+			fps = strtol(argv[++i], NULL, 10);
+		else if (strcmp(argv[i], "-frames") == 0 &&
+		    i + 1 < (size_t) argc)
+			nframes = strtoull(argv[++i], NULL, 10);
+		else if (kind == -1 && (kind = synth_kind(argv[i])) != -1)
+			continue;
+		else
+			usage(argv[0]);
+	}
+	if (kind == -1 || fps < 0 || fps > 1000)
+		usage(argv[0]);
+
+	synth_init(&synth, kind);
+	frame_ns = (fps > 0) ? 1000000000 / fps : 0;
+	if (clock_gettime(CLOCK_MONOTONIC, &next) == -1)
+		err(1, "clock_gettime");
+	for (frame = 0; frame < nframes; frame++) {
+		nrows = synth_frame_rows(&synth, frame);
+		for (i = 0; i < nrows; i++) {
+			n = synth_row(&synth, row);
+			for (j = 0; j < n; j++)
+				printf(j == 0 ? "%.3f" : " %.3f", row[j]);
+			putchar('\n');
+		}
+		if (fflush(stdout) == EOF)
+			err(1, "stdout");
+
+		if (frame_ns > 0) {
+			next.tv_nsec += frame_ns;
+			if (next.tv_nsec >= 1000000000) {
+				next.tv_sec++;
+				next.tv_nsec -= 1000000000;
+			}
+			while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+			    &next, NULL) != 0)
+				;
+		}
+	}
+
+	return 0;
+}
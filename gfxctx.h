@@ -1,6 +1,10 @@
 #ifndef GFXCTX_H
 #define GFXCTX_H
 
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
 struct gfxctx;
 
 /*
@@ -14,9 +18,42 @@ gfxctx_open(
 
 struct gfxwin;
 
+/*
+ * gfxseg: line segment, same layout as XSegment.
+ */
+struct gfxseg
+{
+	short x1, y1, x2, y2;
+};
+
 int
 gfxwin_textwidth(struct gfxwin *win, char *buf);
 
+/*
+ * gfxwin_textheight: height of a line of text.
+ */
+int
+gfxwin_textheight(
+	struct gfxwin *
+);
+
+/*
+ * gfxwin_draw_text: draw text in the foreground color on the
+ * background color, the top of the text at y. The null backend has
+ * no font and draws nothing.
+ */
+void
+gfxwin_draw_text(
+	struct gfxwin *,
+	int,             /* x */
+	int,             /* y */
+	const char *
+);
+
+/*
+ * gfxwin_process_events: handle every pending event, each window
+ * redrawn at most once for exposures and resizes, then flush.
+ */
 void
 gfxwin_process_events(
 	struct gfxctx *
@@ -28,6 +65,15 @@ gfxwin_set_draw_callback(
 	void (*)(struct gfxwin *)
 );
 
+/*
+ * gfxwin_set_key_callback: called with the character of a key press.
+ */
+void
+gfxwin_set_key_callback(
+	struct gfxwin *,
+	void (*)(struct gfxwin *, int)
+);
+
 void*
 gfxwin_data(
 	struct gfxwin *
@@ -52,6 +98,41 @@ gfxwin_create(
 	void *           /* optional user data */
 );
 
+/*
+ * gfxwin_create_panel: area of a window that is drawn like a window of
+ * its own, sharing the colors, GCs and pixmap of the window. Key
+ * presses and resizes of the window are passed to the callbacks of its
+ * panels after its own.
+ */
+struct gfxwin*
+gfxwin_create_panel(
+	struct gfxwin *, /* window */
+	int,             /* x */
+	int,             /* y */
+	unsigned int,    /* width */
+	unsigned int,    /* height */
+	void *           /* optional user data */
+);
+
+/*
+ * gfxwin_move_panel: set position and size of a panel, e.g. on resize
+ * of the window. Nothing is drawn.
+ */
+void
+gfxwin_move_panel(
+	struct gfxwin *,
+	int,             /* x */
+	int,             /* y */
+	unsigned int,    /* width */
+	unsigned int     /* height */
+);
+
+void
+gfxwin_set_data(
+	struct gfxwin *,
+	void *
+);
+
 /*
  * gfxwin_draw_line: draw line.
  */
@@ -64,6 +145,47 @@ gfxwin_draw_line(
 	int              /* y2 */
 );
 
+/*
+ * Colors for drawing.
+ */
+#define GFXWIN_FG	0	/* Foreground */
+#define GFXWIN_HL	1	/* Highlight */
+
+/*
+ * gfxwin_alloc_color: allocate another color for drawing, returns the
+ * color for gfxwin_draw_segments().
+ */
+int
+gfxwin_alloc_color(
+	struct gfxwin *,
+	const char *     /* color spec */
+);
+
+/*
+ * gfxwin_draw_segments: draw many lines in one request.
+ */
+void
+gfxwin_draw_segments(
+	struct gfxwin *,
+	int,             /* color */
+	const struct gfxseg *,
+	size_t           /* number of segments */
+);
+
+/*
+ * gfxwin_copy_area: copy area within the window, e.g. for scrolling.
+ */
+void
+gfxwin_copy_area(
+	struct gfxwin *,
+	int,             /* source x */
+	int,             /* source y */
+	unsigned int,    /* width */
+	unsigned int,    /* height */
+	int,             /* destination x */
+	int              /* destination y */
+);
+
 void
 gfxwin_clear(
 	struct gfxwin *,
@@ -88,4 +210,23 @@ gfxctx_fd(
 	struct gfxctx *
 );
 
+/*
+ * gfxctx_pending: whether events were already read from the descriptor
+ * and are waiting for gfxwin_process_events(), such as those read while
+ * waiting for a reply.
+ */
+bool
+gfxctx_pending(
+	struct gfxctx *
+);
+
+/*
+ * gfxctx_first_frame: nanoseconds from gfxctx_open() until the server
+ * had shown the first window, or 0 if it has not yet.
+ */
+int64_t
+gfxctx_first_frame(
+	struct gfxctx *
+);
+
 #endif
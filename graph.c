@@ -3,176 +3,887 @@
  */
 
 #include "graph.h"
+#include "derive.h"
 #include "graphview.h"
+#include "stats.h"
+#include "trace.h"
 #include "util.h"
 
 #include <stdlib.h>
 #include <string.h>
 #include <err.h>
 #include <stdint.h>
+#include <stdbool.h>
 #include <math.h>
 
-struct value
+/*
+ * MAX_LEVELS: Enough for 4^15 values per bucket.
+ */
+#define MAX_LEVELS		16
+
+/*
+ * Monotonic deque of the stored values: the front is the extremum of
+ * the window and each value is pushed and popped at most once, so
+ * keeping the extremum up to date is amortized O(1) per value.
+ */
+struct extremum
+{
+	uint64_t *seq;
+	double *val;
+	size_t cap;
+	size_t head;
+	size_t len;
+	int sign;		/* 1 for maximum, -1 for minimum */
+};
+
+/*
+ * Pyramid level: values aggregated to buckets of 4^n values, so that
+ * at any zoom a view reads one bucket per column instead of every
+ * value. Bucket b holds the values whose sequence number divided by
+ * the bucket size is b, and is found at b % cap. The count is shared
+ * by all series, the aggregates are per series.
+ */
+struct level
+{
+	uint32_t *count;
+	size_t cap;
+	unsigned int shift;	/* log2 of bucket size */
+};
+
+struct aggregate
+{
+	double *min;
+	double *max;
+	double *sum;
+};
+
+/*
+ * Series: one value column and its aggregates.
+ */
+struct series
 {
-	time_t time;
-	double val;
+	double *val;
+	struct aggregate agg[MAX_LEVELS];
+	struct extremum max;
+	struct extremum min;
+	bool lttb_valid;	/* Point picked for bucket lttb_b */
+	uint64_t lttb_b;
+	double lttb_x;
+	double lttb_y;
 };
 
+/*
+ * Values are kept in ring buffers allocated once per series, a value
+ * column for each. The oldest row is at 'first' and the newest
+ * 'nvalue - 1' after it. Row with sequence number s (counting from
+ * zero) is at s % cap. Columns are drawn one per row, or per bucket
+ * when zoomed out, whatever the time of the rows.
+ *
+ * Level 0 of the pyramid is the ring buffer itself. Times, used to
+ * gather rows and for rates, are nanoseconds since graph->base, the
+ * time of the first row.
+ */
 struct graph
 {
-	struct value value[4096];
-	double maxval;	
-	struct graphview *view;
-	time_t bound;
+	size_t cap;
+	size_t first;
 	size_t nvalue;
-	size_t index;
-	double zoom_level;
+	struct series *series[GRAPH_MAX_SERIES];
+	size_t nseries;
+
+	/*
+	 * Series are the columns of the input, from 0 on, then the
+	 * series derived from them. A column may also be replaced by a
+	 * series derived from it.
+	 */
+	size_t ncolumns;
+	struct derive *transform[GRAPH_MAX_SERIES];
+	struct derive *derived[GRAPH_MAX_SERIES];
+	size_t derived_from[GRAPH_MAX_SERIES];
+	size_t nderived;
+	struct level level[MAX_LEVELS];
+	unsigned int nlevel;
+	double maxval;
+	double minval;
+	uint64_t seq;		/* Number of rows added */
+	uint64_t drawn;		/* Number of rows drawn */
+	double *drawlo;
+	double *drawhi;
+	size_t ndraw;
+	int reduce;		/* How buckets are shown, GRAPH_REDUCE_* */
+	bool dirty;		/* Scale changed, full refresh needed */
+
+	/*
+	 * Values of the row being gathered. Values of other columns
+	 * arriving at nearly the same time join it, see add_row().
+	 */
+	double pend[GRAPH_MAX_SERIES];
+	uint64_t pend_mask;	/* Columns with a value in pend */
+	int64_t pend_t;
+	bool pending;
+	struct graphview *view;
+	int64_t base;		/* Nanoseconds since the Epoch */
+	bool have_base;
+	unsigned int zoom;	/* Pyramid level shown */
 };
 
-static double mkpos(time_t, double);
-static void draw_value(struct graph *, struct value *, double pos);
+static struct graph *graph_alloc(size_t);
+static void extremum_init(struct extremum *, size_t, int);
+static void extremum_push(struct extremum *, uint64_t, double, uint64_t);
+static double scale(struct graph *, double);
+static void pyramid_init(struct graph *);
+static void pyramid_add(struct graph *, uint64_t);
+static void add_row(struct graph *, int64_t, size_t, const double *, size_t);
+static void commit_row(struct graph *);
+static void add_column(struct graph *);
+static bool column_value(struct graph *, size_t, int64_t, struct derive *,
+    double *);
+static struct series *series_create(struct graph *);
+static void series_add(struct graph *, struct series *, uint64_t, double);
+static void column(struct graph *, struct series *, uint64_t, double *,
+    double *);
+static double lttb(struct graph *, struct series *, uint64_t);
+static void draw_columns(struct graph *, uint64_t, uint64_t, size_t);
 
-#define DAY_SECS		(24 * 60 * 60)
-#define DEFAULT_ZOOM_LEVEL	0.01
+#define MERGE_NS		INT64_C(10000000)
 
-struct graph*
-graph_create(struct gfxctx *ctx)
+static struct graph *
+graph_alloc(size_t history)
 {
 	struct graph *graph;
 
 	if ((graph = calloc(1, sizeof(struct graph))) == NULL)
 		err(1, "allocate graph");
 
-	graph->maxval = 0.0;
+	if (history == 0)
+		errx(1, "history must be at least one value");
+	graph->cap = history;
+	graph->first = 0;
 	graph->nvalue = 0;
-	graph->index = 0;
-	graph->zoom_level = DEFAULT_ZOOM_LEVEL;
+	pyramid_init(graph);
+
+	graph->series[0] = series_create(graph);
+	graph->nseries = 1;
+	graph->ncolumns = 1;
+	graph->maxval = 0.0;
+	graph->minval = 0.0;
+	graph->seq = 0;
+	graph->drawn = 0;
+	graph->zoom = 0;
+	graph->have_base = false;
+	graph->reduce = GRAPH_REDUCE_MAX;
+
+	return graph;
+}
+
+struct graph*
+graph_create(struct gfxctx *ctx, size_t history)
+{
+	struct graph *graph;
+
+	graph = graph_alloc(history);
 	graph->view = graphview_open(graph, ctx);
+	graph_zoom(graph, 0);
+
+	return graph;
+}
+
+/*
+ * graph_create_in: graph drawn in win, which is given to the graph.
+ */
+struct graph*
+graph_create_in(struct gfxwin *win, size_t history)
+{
+	struct graph *graph;
 
+	graph = graph_alloc(history);
+	graph->view = graphview_open_in(graph, win);
 	graph_zoom(graph, 0);
 
 	return graph;
 }
 
-static double
-mkpos(time_t t, double bound)
+/*
+ * pyramid_init: set up levels until one bucket holds all values. The
+ * aggregates are allocated per series by series_create().
+ */
+static void
+pyramid_init(struct graph *graph)
 {
-	struct tm *tm;
+	struct level *l;
+	unsigned int i;
+	size_t n;
 
-	tm = localtime(&t);
-	t = tm->tm_sec + (tm->tm_min * 60) + (tm->tm_hour * 60 * 60);
-	t %= (time_t) bound;
+	graph->nlevel = 1;
+	while (graph->nlevel < MAX_LEVELS &&
+	    (UINT64_C(1) << (2 * (graph->nlevel - 1))) < graph->cap)
+		graph->nlevel++;
 
-	return t / bound;
+	for (i = 1; i < graph->nlevel; i++) {
+		l = &graph->level[i];
+		l->shift = 2 * i;
+
+		/*
+		 * Partial buckets at both ends of the stored values.
+		 */
+		n = (graph->cap >> l->shift) + 2;
+		if ((l->count = calloc(n, sizeof(uint32_t))) == NULL)
+			err(1, "allocate pyramid level %u", i);
+		l->cap = n;
+	}
 }
 
+/*
+ * pyramid_add: count row with sequence number s on each level, which
+ * is O(log n) per row. The aggregates are updated by series_add().
+ */
 static void
-draw_value(struct graph *graph, struct value *v, double pos)
+pyramid_add(struct graph *graph, uint64_t s)
 {
-	double val;
+	struct level *l;
+	unsigned int i;
+	size_t j;
 
-	val = v->val / graph->maxval;
-	graphview_draw_value(graph->view, pos, val);
+	for (i = 1; i < graph->nlevel; i++) {
+		l = &graph->level[i];
+		j = (s >> l->shift) % l->cap;
+		if ((s & ((UINT64_C(1) << l->shift) - 1)) == 0)
+			l->count[j] = 1;
+		else
+			l->count[j]++;
+	}
 }
 
+/*
+ * series_create: allocate value column and aggregates. Rows added
+ * before the series existed read as zero.
+ */
+static struct series *
+series_create(struct graph *graph)
+{
+	struct series *series;
+	struct aggregate *a;
+	unsigned int i;
+	size_t n;
+
+	if ((series = calloc(1, sizeof(struct series))) == NULL)
+		err(1, "allocate series");
+	if ((series->val = calloc(graph->cap, sizeof(double))) == NULL)
+		err(1, "allocate %zu values", graph->cap);
+
+	for (i = 1; i < graph->nlevel; i++) {
+		a = &series->agg[i];
+		n = graph->level[i].cap;
+		a->min = calloc(n, sizeof(double));
+		a->max = calloc(n, sizeof(double));
+		a->sum = calloc(n, sizeof(double));
+		if (a->min == NULL || a->max == NULL || a->sum == NULL)
+			err(1, "allocate pyramid level %u", i);
+	}
+
+	extremum_init(&series->max, graph->cap, 1);
+	extremum_init(&series->min, graph->cap, -1);
+	series->lttb_valid = false;
+	return series;
+}
+
+/*
+ * series_add: store value of row s and update aggregates and
+ * extremums, expiring the value overwritten.
+ */
+static void
+series_add(struct graph *graph, struct series *series, uint64_t s,
+    double val)
+{
+	struct aggregate *a;
+	struct level *l;
+	unsigned int i;
+	uint64_t oldest;
+	size_t j;
+
+	series->val[s % graph->cap] = val;
+
+	for (i = 1; i < graph->nlevel; i++) {
+		l = &graph->level[i];
+		a = &series->agg[i];
+		j = (s >> l->shift) % l->cap;
+		if ((s & ((UINT64_C(1) << l->shift) - 1)) == 0)
+			a->min[j] = a->max[j] = a->sum[j] = val;
+		else {
+			a->min[j] = MIN(a->min[j], val);
+			a->max[j] = MAX(a->max[j], val);
+			a->sum[j] += val;
+		}
+	}
+
+	oldest = s + 1 - graph->nvalue + 1;
+	extremum_push(&series->max, s + 1, val, oldest);
+	extremum_push(&series->min, s + 1, val, oldest);
+}
+
+static void
+extremum_init(struct extremum *ext, size_t cap, int sign)
+{
+	ext->seq = calloc(cap, sizeof(uint64_t));
+	ext->val = calloc(cap, sizeof(double));
+	if (ext->seq == NULL || ext->val == NULL)
+		err(1, "allocate extremum");
+	ext->cap = cap;
+	ext->head = 0;
+	ext->len = 0;
+	ext->sign = sign;
+}
+
+/*
+ * extremum_push: add value with sequence number seq, expiring values
+ * older than the oldest sequence number still stored.
+ */
+static void
+extremum_push(struct extremum *ext, uint64_t seq, double val, uint64_t oldest)
+{
+	size_t back;
+
+	while (ext->len > 0 && ext->seq[ext->head] < oldest) {
+		ext->head = (ext->head + 1) % ext->cap;
+		ext->len--;
+	}
+
+	while (ext->len > 0) {
+		back = (ext->head + ext->len - 1) % ext->cap;
+		if (ext->sign * ext->val[back] > ext->sign * val)
+			break;
+		ext->len--;
+	}
+
+	back = (ext->head + ext->len) % ext->cap;
+	ext->seq[back] = seq;
+	ext->val[back] = val;
+	ext->len++;
+}
+
+/*
+ * scale: map value to 0..1 so that zero is always included.
+ */
+static double
+scale(struct graph *graph, double val)
+{
+	double lo, hi;
+
+	lo = MIN(graph->minval, 0.0);
+	hi = MAX(graph->maxval, 0.0);
+	if (hi == lo)
+		return 0.0;
+
+	return (val - lo) / (hi - lo);
+}
+
+/*
+ * graph_add_data: add value at t nanoseconds since the Epoch.
+ */
 void
-graph_add_data(struct graph *graph, time_t t, double val)
+graph_add_data(struct graph *graph, int64_t t, double val)
+{
+	graph_add_row(graph, t, &val, 1);
+}
+
+/*
+ * graph_add_row: add values of n series at t nanoseconds since the
+ * Epoch. Series are created as rows get more columns, and series
+ * missing from a shorter row repeat their previous value.
+ */
+void
+graph_add_row(struct graph *graph, int64_t t, const double *val, size_t n)
+{
+	add_row(graph, t, 0, val, MIN(n, GRAPH_MAX_SERIES));
+}
+
+/*
+ * graph_add_value: add value of one series. It joins the values of
+ * other series at nearly the same time in one row, see add_row().
+ */
+void
+graph_add_value(struct graph *graph, int64_t t, size_t series, double val)
+{
+	if (series >= GRAPH_MAX_SERIES)
+		errx(1, "series %zu out of range", series);
+	add_row(graph, t, series, &val, 1);
+}
+
+/*
+ * graph_add_values: add n values of one series at the same time, one
+ * row each, straight from the caller's buffer.
+ */
+void
+graph_add_values(struct graph *graph, int64_t t, size_t series,
+    const double *val, size_t n)
+{
+	size_t i;
+
+	if (series >= GRAPH_MAX_SERIES)
+		errx(1, "series %zu out of range", series);
+	for (i = 0; i < n; i++)
+		add_row(graph, t, series, &val[i], 1);
+}
+
+/*
+ * add_row: add values of series first..first+n-1 at t. Producers that
+ * each send their own columns, like several clients of a socket, or
+ * sources read on the same tick, give values of one moment one by
+ * one, so values of columns not yet in the pending row join it while
+ * they are at most MERGE_NS later. A column given again, an older
+ * time or a later one starts a new row.
+ */
+static void
+add_row(struct graph *graph, int64_t t, size_t first, const double *val,
+    size_t n)
 {
-	struct value *v;
+	uint64_t mask;
 	size_t i;
-	double pos, oldpos;
-	double old_maxval, old_val;
+
+	if (!graph->have_base) {
+		graph->base = t;
+		graph->have_base = true;
+	}
+	t -= graph->base;
+
+	n = MIN(first + n, GRAPH_MAX_SERIES - graph->nderived) -
+	    MIN(first, GRAPH_MAX_SERIES - graph->nderived);
+	mask = 0;
+	for (i = first; i < first + n; i++)
+		mask |= UINT64_C(1) << i;
+
+	if (graph->pending && ((graph->pend_mask & mask) != 0 ||
+	    t < graph->pend_t || t - graph->pend_t > MERGE_NS))
+		commit_row(graph);
+	if (!graph->pending) {
+		graph->pend_t = t;
+		graph->pend_mask = 0;
+		graph->pending = true;
+	}
+	for (i = 0; i < n; i++)
+		graph->pend[first + i] = val[i];
+	graph->pend_mask |= mask;
+	STATS_ADD(values, n);
+}
+
+/*
+ * commit_row: add the pending row to the graph. Columns without a
+ * value, and values that are not finite, such as NaN from binary
+ * input, repeat the previous value.
+ */
+static void
+commit_row(struct graph *graph)
+{
+	struct series *series;
+	double old_lo, old_hi, v;
+	uint64_t s;
+	int64_t t;
+	size_t i, n;
+	bool ok;
+
+	if (!graph->pending)
+		return;
+	graph->pending = false;
+	t = graph->pend_t;
+
+	for (n = 0; n < GRAPH_MAX_SERIES; n++)
+		if ((graph->pend_mask >> n) == 0)
+			break;
+	while (graph->ncolumns < n)
+		add_column(graph);
+
+	/*
+	 * Overwrite the oldest row when full.
+	 */
+	s = graph->seq;
+	if (graph->nvalue == graph->cap)
+		graph->first = (graph->first + 1) % graph->cap;
+	else
+		graph->nvalue++;
+	pyramid_add(graph, s);
+
+	old_lo = MIN(graph->minval, 0.0);
+	old_hi = MAX(graph->maxval, 0.0);
+	for (i = 0; i < graph->nseries; i++) {
+		series = graph->series[i];
+		if (i < graph->ncolumns) {
+			/*
+			 * Series derived from the column are fed its
+			 * value as shown, after any transform.
+			 */
+			ok = column_value(graph, i, t, graph->transform[i], &v);
+			if (ok)
+				graph->pend[i] = v;
+			else
+				graph->pend_mask &= ~(UINT64_C(1) << i);
+		} else
+			ok = column_value(graph, graph->derived_from[i -
+			    graph->ncolumns], t, graph->derived[i -
+			    graph->ncolumns], &v);
+		if (!ok)
+			v = (s > 0) ? series->val[(s - 1) % graph->cap] : 0.0;
+		series_add(graph, series, s, v);
+
+		v = series->max.val[series->max.head];
+		if (i == 0 || v > graph->maxval)
+			graph->maxval = v;
+		v = series->min.val[series->min.head];
+		if (i == 0 || v < graph->minval)
+			graph->minval = v;
+	}
+	graph->seq++;
 
 	/*
-	 * If we have same pos value, let's ignore the entry.
+	 * Drawing is left to graph_draw() so that any number of rows
+	 * can be added between frames.
 	 */
-#if 0
-	pos = mkpos(t, graph->bound);
-	if (graph->index > 0) {
-		oldv = &graph->value[graph->index - 1];
-		oldpos = mkpos(oldv->time, graph->bound);
-		if (oldpos == pos) {
-			warnx("ignored, same pos");
-			return;
+	if (old_lo != MIN(graph->minval, 0.0) ||
+	    old_hi != MAX(graph->maxval, 0.0))
+		graph->dirty = true;
+}
+
+/*
+ * column_value: value of column i in the pending row, or if d is given
+ * the value derived from it. Returns false if there is none, for the
+ * previous value to be repeated.
+ */
+static bool
+column_value(struct graph *graph, size_t i, int64_t t, struct derive *d,
+    double *v)
+{
+	if ((graph->pend_mask & (UINT64_C(1) << i)) == 0 ||
+	    !isfinite(graph->pend[i]))
+		return false;
+	if (d == NULL) {
+		*v = graph->pend[i];
+		return true;
+	}
+	return derive_push(d, t, graph->pend[i], v) && isfinite(*v);
+}
+
+/*
+ * add_column: add series for a new column, before the derived series,
+ * which then need redrawing in their new colors.
+ */
+static void
+add_column(struct graph *graph)
+{
+	size_t i;
+
+	for (i = graph->nseries; i > graph->ncolumns; i--)
+		graph->series[i] = graph->series[i - 1];
+	graph->series[graph->ncolumns++] = series_create(graph);
+	graph->nseries++;
+	if (graph->nderived > 0)
+		graph->dirty = true;
+}
+
+/*
+ * graph_derive: derive a series from column in O(1) per value, see
+ * GRAPH_DERIVE_*. With keep, the series is added after the columns
+ * and derived from the column as shown, after any transform,
+ * otherwise it replaces the column. Param is the window of a moving
+ * average in values or the weight of a new value in an EWMA. Called
+ * before values are added.
+ */
+void
+graph_derive(struct graph *graph, size_t column, int kind, double param,
+    bool keep)
+{
+	struct derive *d;
+
+	if (column >= GRAPH_MAX_SERIES - graph->nderived - keep)
+		errx(1, "column %zu out of range", column);
+	d = derive_create(kind, param);
+	if (!keep) {
+		if (graph->transform[column] != NULL)
+			errx(1, "column %zu replaced twice", column);
+		graph->transform[column] = d;
+		return;
+	}
+
+	graph->derived[graph->nderived] = d;
+	graph->derived_from[graph->nderived] = column;
+	graph->nderived++;
+	graph->series[graph->nseries++] = series_create(graph);
+}
+
+/*
+ * graph_nseries: number of series, i.e. columns in the widest row and
+ * the series derived from them.
+ */
+size_t
+graph_nseries(struct graph *graph)
+{
+	return graph->nseries;
+}
+
+/*
+ * column: value range of bucket b of a series at the current zoom
+ * level, reduced to a single value unless showing the envelope.
+ */
+static void
+column(struct graph *graph, struct series *series, uint64_t b, double *lo,
+    double *hi)
+{
+	struct aggregate *a;
+	size_t j;
+
+	if (graph->zoom == 0) {
+		*lo = *hi = scale(graph, series->val[b % graph->cap]);
+		return;
+	}
+
+	a = &series->agg[graph->zoom];
+	j = b % graph->level[graph->zoom].cap;
+	switch (graph->reduce) {
+	case GRAPH_REDUCE_AVG:
+		*lo = *hi = scale(graph, a->sum[j] /
+		    graph->level[graph->zoom].count[j]);
+		break;
+	case GRAPH_REDUCE_ENVELOPE:
+		*lo = scale(graph, a->min[j]);
+		*hi = scale(graph, a->max[j]);
+		break;
+	case GRAPH_REDUCE_LTTB:
+		*lo = *hi = scale(graph, lttb(graph, series, b));
+		break;
+	default:
+		*lo = *hi = scale(graph, a->max[j]);
+		break;
+	}
+}
+
+/*
+ * lttb: Largest-Triangle-Three-Buckets. Pick the value of bucket b that
+ * forms the largest triangle with the value picked for the previous
+ * bucket and the average of the next bucket. Costs a pass over the
+ * values of the bucket, but still draws one value per column.
+ */
+static double
+lttb(struct graph *graph, struct series *series, uint64_t b)
+{
+	struct level *l;
+	uint64_t s, from, to, oldest;
+	double ax, ay, cx, cy, y, area, best, picked;
+	size_t j;
+
+	if (series->lttb_valid && series->lttb_b == b)
+		return series->lttb_y;
+
+	l = &graph->level[graph->zoom];
+	oldest = graph->seq - graph->nvalue;
+	from = MAX(b << l->shift, oldest);
+	to = MIN((b + 1) << l->shift, graph->seq);
+
+	/*
+	 * Previous point, or the value before the bucket if we did not
+	 * pick one, e.g. on the left edge.
+	 */
+	if (series->lttb_valid && series->lttb_b + 1 == b) {
+		ax = series->lttb_x;
+		ay = series->lttb_y;
+	} else {
+		ax = (from > oldest) ? from - 1 : from;
+		ay = series->val[(uint64_t) ax % graph->cap];
+	}
+
+	/*
+	 * Average of the next bucket, or the newest value if there is
+	 * none yet.
+	 */
+	if (to < graph->seq) {
+		j = (b + 1) % l->cap;
+		cx = to + l->count[j] / 2.0;
+		cy = series->agg[graph->zoom].sum[j] / l->count[j];
+	} else {
+		cx = to - 1;
+		cy = series->val[(to - 1) % graph->cap];
+	}
+
+	best = -1.0;
+	picked = 0.0;
+	for (s = from; s < to; s++) {
+		y = series->val[s % graph->cap];
+		area = fabs((ax - cx) * (y - ay) - (ax - s) * (cy - ay));
+		if (area > best) {
+			best = area;
+			picked = y;
+			series->lttb_x = s;
 		}
 	}
-#else
-	oldpos = 0.0;
-	pos = 0.0;
-#endif
 
 	/*
-	 * Wraparound if we're at array limit or if time-based position
-	 * turns over.
+	 * Remember the pick once the bucket is complete.
 	 */
-	if (graph->index == ARRLEN(graph->value) || oldpos > pos)
-		graph->index = 0;
+	series->lttb_valid = (to == (b + 1) << l->shift);
+	series->lttb_b = b;
+	series->lttb_y = picked;
 
-	v = &graph->value[graph->index];
-	graph->index++;
-	if (graph->index > graph->nvalue)
-		graph->nvalue = graph->index;
+	return picked;
+}
 
-	old_val = v->val;
-	v->time = t;
-	v->val = val;
+/*
+ * draw_columns: draw buckets from..to (inclusive), of which 'replace'
+ * first ones are already shown but were incomplete then. The column
+ * before 'from' goes along so that lines can be joined to it.
+ */
+static void
+draw_columns(struct graph *graph, uint64_t from, uint64_t to, size_t replace)
+{
+	size_t i, k, n, columns, stride;
+	uint64_t oldest;
+	double *lo, *hi;
 
-	if (old_val == graph->maxval) {
-		/*
-		 * If we're overwriting old maxvalue, find if we've
-		 * got other entry at same value or next highest.
-		 */
-		old_maxval = graph->maxval;
-		for (i = 0; i < graph->nvalue; i++)
-			if (graph->value[i].val >= graph->maxval)
-				graph->maxval = graph->value[i].val;
-
-		if (old_maxval != graph->maxval)
-			graph_refresh_view(graph);
-	} else if (v->val > graph->maxval) {
-		graph->maxval = v->val;
+	columns = graphview_columns(graph->view);
+	if (to - from + 1 > columns) {
+		from = to - columns + 1;
+		replace = 0;
+	}
+	n = to - from + 1;
+	stride = n + 1;
+
+	if (graph->nseries * stride > graph->ndraw) {
+		graph->drawlo = realloc(graph->drawlo,
+		    graph->nseries * stride * sizeof(double));
+		graph->drawhi = realloc(graph->drawhi,
+		    graph->nseries * stride * sizeof(double));
+		if (graph->drawlo == NULL || graph->drawhi == NULL)
+			err(1, "allocate draw buffer");
+		graph->ndraw = graph->nseries * stride;
+	}
+
+	/*
+	 * Value columns series by series.
+	 */
+	oldest = (graph->seq - graph->nvalue) >>
+	    ((graph->zoom == 0) ? 0 : graph->level[graph->zoom].shift);
+
+	for (k = 0; k < graph->nseries; k++) {
+		lo = &graph->drawlo[k * stride];
+		hi = &graph->drawhi[k * stride];
+		if (from > oldest)
+			column(graph, graph->series[k], from - 1, &lo[0],
+			    &hi[0]);
+		else
+			lo[0] = hi[0] = NAN;
+		for (i = 0; i < n; i++)
+			column(graph, graph->series[k], from + i, &lo[i + 1],
+			    &hi[i + 1]);
+	}
+
+	graphview_draw_values(graph->view, graph->drawlo, graph->drawhi,
+	    graph->nseries, n, replace);
+}
+
+/*
+ * graph_draw: draw what has changed since the previous call, i.e. one
+ * frame.
+ */
+void
+graph_draw(struct graph *graph)
+{
+	unsigned int shift;
+	uint64_t from, to, ncol;
+	size_t replace;
+	int64_t t0;
+
+	commit_row(graph);
+	if (graph->dirty) {
 		graph_refresh_view(graph);
+		return;
 	}
-	draw_value(graph, v, pos);
+	if (graph->drawn == graph->seq)
+		return;
+
+	t0 = TRACE_BEGIN();
+
+	/*
+	 * Redraw the newest bucket drawn previously if it was not yet
+	 * complete back then.
+	 */
+	shift = (graph->zoom == 0) ? 0 : graph->level[graph->zoom].shift;
+	to = (graph->seq - 1) >> shift;
+	if (graph->drawn == 0) {
+		from = 0;
+		replace = 0;
+	} else if ((graph->drawn & ((UINT64_C(1) << shift) - 1)) == 0) {
+		from = graph->drawn >> shift;
+		replace = 0;
+	} else {
+		from = (graph->drawn - 1) >> shift;
+		replace = 1;
+	}
+	if (from < (graph->seq - graph->nvalue) >> shift) {
+		from = (graph->seq - graph->nvalue) >> shift;
+		replace = 0;
+	}
+	draw_columns(graph, from, to, replace);
+
+	/*
+	 * Rows that did not get a new column of their own.
+	 */
+	ncol = MIN(to - from + 1 - replace, graphview_columns(graph->view));
+	if (graph->seq - graph->drawn > ncol)
+		STATS_ADD(coalesced, graph->seq - graph->drawn - ncol);
+
+	graph->drawn = graph->seq;
+	TRACE_END("draw", t0);
 }
 
 void
 graph_refresh_view(struct graph *graph)
 {
-	struct value *v;
+	unsigned int shift;
+	int64_t t0;
 	size_t i;
-	double old_pos = 0.0, pos;
+
+	commit_row(graph);
+	t0 = TRACE_BEGIN();
 
 	/*
 	 * This is required in case of floating point errors where
 	 * x axis does not align up with previous content.
 	 */
 	graphview_clear(graph->view);
+	STATS_ADD(refreshes, 1);
 
-	for (i = 0; i < graph->nvalue; i++) {
-		v = &graph->value[i];
-		pos = mkpos(v->time, graph->bound);
-		if (pos < old_pos) {	/* Wraparound. */
-			break;
-		}
-		draw_value(graph, v, pos);
-		old_pos = pos;
+	for (i = 0; i < graph->nseries; i++)
+		graph->series[i]->lttb_valid = false;
+	if (graph->nvalue > 0) {
+		shift = (graph->zoom == 0) ? 0 :
+		    graph->level[graph->zoom].shift;
+		draw_columns(graph, (graph->seq - graph->nvalue) >> shift,
+		    (graph->seq - 1) >> shift, 0);
 	}
+
+	graph->drawn = graph->seq;
+	graph->dirty = false;
+	TRACE_END("refresh", t0);
 }
 
 /*
- * direction == 0 recalculates bound.
+ * direction == 0 redraws at the same zoom. Zooming out by one step
+ * shows four times as many values per column, read from the pyramid.
  */
 void
 graph_zoom(struct graph *graph, int direction)
-{	
-	if (direction < 0)
-		graph->zoom_level /= 4;
-	else if (direction > 0)
-		graph->zoom_level *= 4;
-	if (graph->zoom_level <= 0.0)
-		graph->zoom_level = DEFAULT_ZOOM_LEVEL;
-
-	graph->bound = (graph->zoom_level / 24.0) * (double) DAY_SECS;
+{
+	if (direction < 0 && graph->zoom > 0)
+		graph->zoom--;
+	else if (direction > 0 && graph->zoom + 1 < graph->nlevel)
+		graph->zoom++;
+
+	graph_refresh_view(graph);
+}
+
+/*
+ * graph_reduce: set how a column shows the values of a bucket when
+ * zoomed out.
+ */
+void
+graph_reduce(struct graph *graph, int reduce)
+{
+	graph->reduce = reduce;
 	graph_refresh_view(graph);
 }
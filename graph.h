@@ -1,14 +1,52 @@
 #ifndef GRAPH_H
 #define GRAPH_H
 
-#include <time.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
 
 struct gfxctx;
+struct gfxwin;
 struct graph;
 
-struct graph* graph_create(struct gfxctx *);
-void graph_add_data(struct graph *, time_t, double);
+/*
+ * How a column shows the values of a bucket when zoomed out.
+ */
+#define GRAPH_REDUCE_MAX	0	/* Largest value */
+#define GRAPH_REDUCE_AVG	1	/* Average */
+#define GRAPH_REDUCE_ENVELOPE	2	/* Range from smallest to largest */
+#define GRAPH_REDUCE_LTTB	3	/* Largest-Triangle-Three-Buckets */
+
+/*
+ * Series derived from the values of a column as they are added.
+ */
+#define GRAPH_DERIVE_RATE	0	/* Per second, of a counter */
+#define GRAPH_DERIVE_DELTA	1	/* Difference to the previous value */
+#define GRAPH_DERIVE_AVG	2	/* Moving average */
+#define GRAPH_DERIVE_EWMA	3	/* Exponentially weighted average */
+
+/*
+ * GRAPH_MAX_SERIES: Maximum number of values on a row.
+ */
+#define GRAPH_MAX_SERIES	64
+
+/*
+ * GRAPH_MAX_WINDOW: Most values in the window of a moving average.
+ */
+#define GRAPH_MAX_WINDOW	(1 << 20)
+
+struct graph* graph_create(struct gfxctx *, size_t);
+struct graph* graph_create_in(struct gfxwin *, size_t);
+void graph_add_data(struct graph *, int64_t, double);
+void graph_add_row(struct graph *, int64_t, const double *, size_t);
+void graph_add_value(struct graph *, int64_t, size_t, double);
+void graph_add_values(struct graph *, int64_t, size_t, const double *,
+    size_t);
+size_t graph_nseries(struct graph *);
+void graph_draw(struct graph *);
 void graph_refresh_view(struct graph *);
 void graph_zoom(struct graph *, int);
+void graph_reduce(struct graph *, int);
+void graph_derive(struct graph *, size_t, int, double, bool);
 
 #endif
@@ -0,0 +1,178 @@
+/*
+ * graphbench - ingest and drawing throughput on synthetic workloads
+ *
+ * Each workload runs in a process of its own with the null backend:
+ * the rows of a frame are added, then the frame is drawn. One line of
+ * JSON is printed per workload, so that results can be compared
+ * between releases.
+ */
+
+#include "graph.h"
+#include "gfxctx.h"
+#include "null.h"
+#include "synth.h"
+#include "util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <err.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#define DEFAULT_FRAMES	2000
+#define DEFAULT_HISTORY	100000
+
+static uint64_t nframes = DEFAULT_FRAMES;
+static size_t history = DEFAULT_HISTORY;
+
+static int64_t
+now_ns(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) == -1)
+		err(1, "clock_gettime");
+
+	return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int
+cmp_int64(const void *a, const void *b)
+{
+	int64_t x = *(const int64_t *) a, y = *(const int64_t *) b;
+
+	return (x > y) - (x < y);
+}
+
+/*
+ * percentile: of sorted values.
+ */
+static int64_t
+percentile(const int64_t *v, size_t n, double p)
+{
+	return v[MIN((size_t) (p * n), n - 1)];
+}
+
+static void
+run(int kind)
+{
+	static char *argv[] = { "graphbench", "-geometry", "640x480", NULL };
+	double row[SYNTH_MAX_SERIES];
+	struct synth synth;
+	struct gfxctx *ctx;
+	struct graph *graph;
+	struct rusage ru;
+	int64_t *frame_ns, t, t0, add_ns, draw_ns;
+	uint64_t frame, samples;
+	unsigned long requests;
+	size_t i, n, nrows;
+	int argc;
+
+	argc = ARRLEN(argv) - 1;
+	if ((ctx = gfxctx_open(&argc, argv)) == NULL)
+		errx(1, "gfxctx_open");
+	graph = graph_create(ctx, history);
+	gfxctx_flush(ctx);
+	requests = null_requests(ctx);
+
+	if ((frame_ns = calloc(nframes, sizeof(int64_t))) == NULL)
+		err(1, "calloc");
+
+	synth_init(&synth, kind);
+	samples = 0;
+	add_ns = draw_ns = 0;
+	for (frame = 0; frame < nframes; frame++) {
+		nrows = synth_frame_rows(&synth, frame);
+		t0 = now_ns();
+		for (i = 0; i < nrows; i++) {
+			n = synth_row(&synth, row);
+			graph_add_row(graph, synth.row * 1000000, row, n);
+			samples += n;
+		}
+		t = now_ns();
+		add_ns += t - t0;
+
+		graph_draw(graph);
+		gfxctx_flush(ctx);
+		frame_ns[frame] = now_ns() - t;
+		draw_ns += frame_ns[frame];
+	}
+	requests = null_requests(ctx) - requests;
+
+	if (getrusage(RUSAGE_SELF, &ru) == -1)
+		err(1, "getrusage");
+	qsort(frame_ns, nframes, sizeof(int64_t), cmp_int64);
+
+	printf("{\"workload\":\"%s\",\"series\":%zu,\"frames\":%llu,"
+	    "\"samples\":%llu,\"samples_per_s\":%.0f,"
+	    "\"frame_ns_p50\":%lld,\"frame_ns_p90\":%lld,"
+	    "\"frame_ns_p99\":%lld,\"frame_ns_max\":%lld,"
+	    "\"draw_ns_mean\":%.0f,\"requests_per_frame\":%.2f,"
+	    "\"peak_rss_kb\":%ld}\n",
+	    synth_name(kind), synth.nseries, (unsigned long long) nframes,
+	    (unsigned long long) samples,
+	    (add_ns > 0) ? samples / (add_ns / 1e9) : 0.0,
+	    (long long) percentile(frame_ns, nframes, 0.5),
+	    (long long) percentile(frame_ns, nframes, 0.9),
+	    (long long) percentile(frame_ns, nframes, 0.99),
+	    (long long) frame_ns[nframes - 1],
+	    draw_ns / (double) nframes, requests / (double) nframes,
+	    ru.ru_maxrss);
+	fflush(stdout);
+}
+
+static void
+usage(const char *progname)
+{
+	fprintf(stderr, "Usage: %s [-frames <n>] [-history <n>] "
+	    "[steady|bursty|ramp|multi ...]\n", progname);
+	exit(1);
+}
+
+int
+main(int argc, char **argv)
+{
+	int kinds[4], nkinds, kind, status, i;
+	pid_t pid;
+
+	nkinds = 0;
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-frames") == 0 && i + 1 < argc)
+			nframes = strtoull(argv[++i], NULL, 10);
+		else if (strcmp(argv[i], "-history") == 0 && i + 1 < argc)
+			history = strtoul(argv[++i], NULL, 10);
+		else if ((kind = synth_kind(argv[i])) != -1 &&
+		    nkinds < (int) ARRLEN(kinds))
+			kinds[nkinds++] = kind;
+		else
+			usage(argv[0]);
+	}
+	if (nframes == 0 || history == 0)
+		usage(argv[0]);
+	if (nkinds == 0)
+		for (kind = SYNTH_STEADY; kind <= SYNTH_MULTI; kind++)
+			kinds[nkinds++] = kind;
+
+	/*
+	 * A process per workload, for its own peak RSS.
+	 */
+	for (i = 0; i < nkinds; i++) {
+		if ((pid = fork()) == -1)
+			err(1, "fork");
+		if (pid == 0) {
+			run(kinds[i]);
+			_exit(0);
+		}
+		if (waitpid(pid, &status, 0) == -1)
+			err(1, "waitpid");
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+			errx(1, "%s failed", synth_name(kinds[i]));
+	}
+
+	return 0;
+}
@@ -0,0 +1,586 @@
+/*
+ * graphcheck - draw fixed input with the null backend and compare the
+ * frames with the golden images in golden/
+ *
+ * Each case is drawn incrementally with graph_draw() and then again
+ * from scratch with graph_refresh_view(); both must match the golden
+ * image. With -u the golden images are rewritten instead, to be
+ * inspected before committing.
+ *
+ * Then series derived from known values are compared with the values
+ * worked out by hand, and the panels of a grid with the window they
+ * share.
+ */
+
+#include "dashboard.h"
+#include "derive.h"
+#include "graph.h"
+#include "gfxctx.h"
+#include "null.h"
+#include "util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <err.h>
+
+#define NSEC		INT64_C(1000000000)
+#define GOLDEN_DIR	"golden"
+
+struct check
+{
+	const char *name;
+	size_t history;
+	void (*feed)(struct graph *);
+};
+
+static void feed_sine(struct graph *);
+static void feed_scroll(struct graph *);
+static void feed_negative(struct graph *);
+static void feed_zoom(struct graph *);
+static void feed_zoom_in(struct graph *);
+static void feed_avg(struct graph *);
+static void feed_envelope(struct graph *);
+static void feed_lttb(struct graph *);
+static void feed_multi(struct graph *);
+static void feed_wrap(struct graph *);
+static void feed_rate_avg(struct graph *);
+
+static const struct check checks[] = {
+	{ "sine",	4096,	feed_sine },
+	{ "scroll",	4096,	feed_scroll },
+	{ "negative",	4096,	feed_negative },
+	{ "zoom",	4096,	feed_zoom },
+	{ "zoom-in",	4096,	feed_zoom_in },
+	{ "avg",	4096,	feed_avg },
+	{ "envelope",	4096,	feed_envelope },
+	{ "lttb",	4096,	feed_lttb },
+	{ "multi",	4096,	feed_multi },
+	{ "wrap",	500,	feed_wrap },
+	{ "rate-avg",	4096,	feed_rate_avg }
+};
+
+struct test
+{
+	const char *name;
+	bool (*run)(void);
+};
+
+static bool test_rate(void);
+static bool test_delta(void);
+static bool test_avg(void);
+static bool test_ewma(void);
+static bool test_layout(void);
+
+static const struct test tests[] = {
+	{ "rate",	test_rate },
+	{ "delta",	test_delta },
+	{ "avg-window",	test_avg },
+	{ "ewma",	test_ewma },
+	{ "layout",	test_layout }
+};
+
+static unsigned long seed;
+
+/*
+ * noise: same sequence on every platform, unlike rand(3).
+ */
+static double
+noise(void)
+{
+	seed = (seed * 1103515245 + 12345) & 0x7fffffff;
+	return seed / (double) 0x7fffffff;
+}
+
+/*
+ * wave: the test signal, a slow sine with some noise.
+ */
+static double
+wave(int i)
+{
+	return 50.0 + 40.0 * sin(i / 25.0) + 5.0 * noise();
+}
+
+static void
+feed_sine(struct graph *graph)
+{
+	int i;
+
+	for (i = 0; i < 150; i++)
+		graph_add_data(graph, i * NSEC, sin(i / 10.0) + 1.0);
+}
+
+/*
+ * feed_scroll: more than fits in the window, drawn in uneven frames.
+ */
+static void
+feed_scroll(struct graph *graph)
+{
+	int i;
+
+	for (i = 0; i < 700; i++) {
+		graph_add_data(graph, i * NSEC, wave(i));
+		if (i % 37 == 0)
+			graph_draw(graph);
+	}
+}
+
+static void
+feed_negative(struct graph *graph)
+{
+	int i;
+
+	for (i = 0; i < 180; i++)
+		graph_add_data(graph, i * NSEC, wave(i) - 50.0);
+}
+
+static void
+feed_zoom(struct graph *graph)
+{
+	int i;
+
+	for (i = 0; i < 3000; i++)
+		graph_add_data(graph, i * NSEC, wave(i) + i / 100.0);
+	graph_zoom(graph, 1);
+}
+
+static void
+feed_zoom_in(struct graph *graph)
+{
+	int i;
+
+	for (i = 0; i < 3000; i++)
+		graph_add_data(graph, i * NSEC, wave(i) + i / 100.0);
+	graph_zoom(graph, 1);
+	graph_zoom(graph, 1);
+	graph_zoom(graph, -1);
+	for (; i < 3300; i++) {
+		graph_add_data(graph, i * NSEC, wave(i) + i / 100.0);
+		if (i % 50 == 0)
+			graph_draw(graph);
+	}
+}
+
+static void
+feed_avg(struct graph *graph)
+{
+	graph_reduce(graph, GRAPH_REDUCE_AVG);
+	feed_zoom(graph);
+}
+
+static void
+feed_envelope(struct graph *graph)
+{
+	graph_reduce(graph, GRAPH_REDUCE_ENVELOPE);
+	feed_zoom(graph);
+}
+
+static void
+feed_lttb(struct graph *graph)
+{
+	graph_reduce(graph, GRAPH_REDUCE_LTTB);
+	feed_zoom(graph);
+}
+
+/*
+ * feed_multi: three series, with short rows and a value that is not
+ * finite, which repeat the previous values.
+ */
+static void
+feed_multi(struct graph *graph)
+{
+	double row[3];
+	int i;
+
+	for (i = 0; i < 250; i++) {
+		row[0] = wave(i);
+		row[1] = 30.0 + i / 5.0;
+		row[2] = (i / 40) % 2 == 0 ? 10.0 : 20.0;
+		if (i == 100)
+			row[0] = NAN;
+		graph_add_row(graph, i * NSEC, row, (i % 60 < 10) ? 1 : 3);
+		if (i % 25 == 0)
+			graph_draw(graph);
+	}
+}
+
+/*
+ * feed_wrap: the history is overwritten several times over.
+ */
+static void
+feed_wrap(struct graph *graph)
+{
+	int i;
+
+	for (i = 0; i < 2000; i++) {
+		graph_add_data(graph, i * NSEC, wave(i) + (i % 500) / 10.0);
+		if (i % 100 == 0)
+			graph_draw(graph);
+	}
+}
+
+/*
+ * feed_rate_avg: a counter replaced by its rate, and the moving
+ * average of the rate, which would dwarf the rate if it averaged the
+ * counter instead.
+ */
+static void
+feed_rate_avg(struct graph *graph)
+{
+	double counter;
+	int i;
+
+	graph_derive(graph, 0, GRAPH_DERIVE_RATE, 0.0, false);
+	graph_derive(graph, 0, GRAPH_DERIVE_AVG, 20.0, true);
+	counter = 1e9;
+	for (i = 0; i < 250; i++) {
+		counter += wave(i);
+		graph_add_data(graph, i * NSEC, counter);
+		if (i % 25 == 0)
+			graph_draw(graph);
+	}
+}
+
+static char *
+frame(struct gfxctx *ctx, size_t *len)
+{
+	char *buf;
+	FILE *fp;
+
+	if ((fp = open_memstream(&buf, len)) == NULL)
+		err(1, "open_memstream");
+	null_write_ppm(ctx, fp);
+	if (fclose(fp) == EOF)
+		err(1, "write frame");
+
+	return buf;
+}
+
+static char *
+read_file(const char *path, size_t *len)
+{
+	char *buf;
+	FILE *fp;
+	long n;
+
+	if ((fp = fopen(path, "r")) == NULL)
+		return NULL;
+	if (fseek(fp, 0, SEEK_END) == -1 || (n = ftell(fp)) == -1 ||
+	    fseek(fp, 0, SEEK_SET) == -1)
+		err(1, "%s", path);
+	if ((buf = malloc(n)) == NULL)
+		err(1, "malloc");
+	if (fread(buf, 1, n, fp) != (size_t) n)
+		err(1, "%s", path);
+	fclose(fp);
+	*len = n;
+
+	return buf;
+}
+
+static void
+write_file(const char *path, const char *buf, size_t len)
+{
+	FILE *fp;
+
+	if ((fp = fopen(path, "w")) == NULL)
+		err(1, "%s", path);
+	if (fwrite(buf, 1, len, fp) != len || fclose(fp) == EOF)
+		err(1, "%s", path);
+}
+
+/*
+ * differ: number of bytes that differ, the whole length if the sizes
+ * do not match.
+ */
+static size_t
+differ(const char *a, size_t alen, const char *b, size_t blen)
+{
+	size_t i, n;
+
+	if (alen != blen)
+		return MAX(alen, blen);
+	for (i = n = 0; i < alen; i++)
+		if (a[i] != b[i])
+			n++;
+
+	return n;
+}
+
+/*
+ * run: check one case, writing the frame to <name>.ppm in the current
+ * directory if it does not match.
+ */
+static bool
+run(const struct check *check, bool update)
+{
+	static char *argv[] = { "graphcheck", "-geometry", "200x100", NULL };
+	char *args[ARRLEN(argv)];
+	char path[256];
+	char *drawn, *redrawn, *golden;
+	size_t drawnlen, redrawnlen, goldenlen, n;
+	struct gfxctx *ctx;
+	struct graph *graph;
+	int argc;
+
+	memcpy(args, argv, sizeof(argv));
+	argc = ARRLEN(argv) - 1;
+	if ((ctx = gfxctx_open(&argc, args)) == NULL)
+		errx(1, "gfxctx_open");
+
+	seed = 1;
+	graph = graph_create(ctx, check->history);
+	check->feed(graph);
+	graph_draw(graph);
+	gfxctx_flush(ctx);
+	drawn = frame(ctx, &drawnlen);
+
+	graph_refresh_view(graph);
+	gfxctx_flush(ctx);
+	redrawn = frame(ctx, &redrawnlen);
+
+	snprintf(path, sizeof(path), "%s/%s.ppm", GOLDEN_DIR, check->name);
+	if (update) {
+		write_file(path, redrawn, redrawnlen);
+		printf("%-10s updated\n", check->name);
+		return true;
+	}
+
+	if ((n = differ(drawn, drawnlen, redrawn, redrawnlen)) > 0) {
+		snprintf(path, sizeof(path), "%s.ppm", check->name);
+		write_file(path, drawn, drawnlen);
+		printf("%-10s FAIL: %zu bytes drawn differ from redrawn, "
+		    "see %s\n", check->name, n, path);
+		return false;
+	}
+	if ((golden = read_file(path, &goldenlen)) == NULL) {
+		printf("%-10s FAIL: no %s\n", check->name, path);
+		return false;
+	}
+	if ((n = differ(redrawn, redrawnlen, golden, goldenlen)) > 0) {
+		snprintf(path, sizeof(path), "%s.ppm", check->name);
+		write_file(path, redrawn, redrawnlen);
+		printf("%-10s FAIL: %zu bytes differ from golden, see %s\n",
+		    check->name, n, path);
+		return false;
+	}
+	printf("%-10s ok\n", check->name);
+
+	free(drawn);
+	free(redrawn);
+	free(golden);
+	return true;
+}
+
+/*
+ * push: push v at t seconds to d and compare with the value expected,
+ * if any.
+ */
+static bool
+push(struct derive *d, int t, double v, bool has, double want)
+{
+	double out;
+	bool got;
+
+	got = derive_push(d, t * NSEC, v, &out);
+	if (got != has || (has && fabs(out - want) > 1e-9)) {
+		if (has && got)
+			printf("\tpush %g at %d: got %g, want %g\n", v, t, out,
+			    want);
+		else
+			printf("\tpush %g at %d: %s value\n", v, t,
+			    got ? "unexpected" : "no");
+		return false;
+	}
+	return true;
+}
+
+/*
+ * test_rate: the first value has no rate, values of the same time
+ * wait for the next, a 32-bit counter wraps and a reset counts from
+ * zero.
+ */
+static bool
+test_rate(void)
+{
+	struct derive *d;
+	bool ok;
+
+	d = derive_create(GRAPH_DERIVE_RATE, 0.0);
+	ok = push(d, 0, 4294967000.0, false, 0.0) &&
+	    push(d, 0, 4294967100.0, false, 0.0) &&
+	    push(d, 2, 200.0, true, 248.0) &&
+	    push(d, 3, 50.0, true, 50.0) &&
+	    push(d, 5, 250.0, true, 100.0);
+	free(d);
+	return ok;
+}
+
+static bool
+test_delta(void)
+{
+	struct derive *d;
+	bool ok;
+
+	d = derive_create(GRAPH_DERIVE_DELTA, 0.0);
+	ok = push(d, 0, 5.0, false, 0.0) &&
+	    push(d, 1, 8.0, true, 3.0) &&
+	    push(d, 2, 2.0, true, -6.0);
+	free(d);
+	return ok;
+}
+
+/*
+ * test_avg: the average of a window not yet full, then of the latest
+ * values. A huge value swallows the small ones added to the running
+ * sum, so the average is only right again once the window is summed
+ * anew.
+ */
+static bool
+test_avg(void)
+{
+	struct derive *d;
+	bool ok;
+
+	d = derive_create(GRAPH_DERIVE_AVG, 3.0);
+	ok = push(d, 0, 1.0, true, 1.0) &&
+	    push(d, 1, 2.0, true, 1.5) &&
+	    push(d, 2, 3.0, true, 2.0) &&
+	    push(d, 3, 4.0, true, 3.0) &&
+	    push(d, 4, 10.0, true, 17.0 / 3.0);
+	free(d->win);
+	free(d);
+	if (!ok)
+		return false;
+
+	d = derive_create(GRAPH_DERIVE_AVG, 2.0);
+	ok = push(d, 0, 1e17, true, 1e17) &&
+	    push(d, 1, 1.0, true, 1e17 / 2) &&
+	    push(d, 2, 1.0, true, 0.5) &&
+	    push(d, 3, 1.0, true, 1.0) &&
+	    push(d, 4, 1.0, true, 1.0);
+	free(d->win);
+	free(d);
+	return ok;
+}
+
+/*
+ * test_ewma: the first value starts the average as it is.
+ */
+static bool
+test_ewma(void)
+{
+	struct derive *d;
+	bool ok;
+
+	d = derive_create(GRAPH_DERIVE_EWMA, 0.1);
+	ok = push(d, 0, 7.0, true, 7.0) &&
+	    push(d, 1, 17.0, true, 8.0) &&
+	    push(d, 2, 8.0, true, 8.0);
+	free(d);
+	return ok;
+}
+
+/*
+ * tiles: whether the panels of a grid of cols x rows cover a window
+ * of width x height, a line apart, the last column and row taking what
+ * is left over.
+ */
+static bool
+tiles(int width, int height, int cols, int rows)
+{
+	static char *argv[] = { "graphcheck", "-geometry", NULL, NULL };
+	char *args[ARRLEN(argv)];
+	char geometry[32];
+	struct dashboard *dash;
+	struct gfxctx *ctx;
+	struct gfxwin *p, *right, *below;
+	int argc, col, row;
+
+	snprintf(geometry, sizeof(geometry), "%dx%d", width, height);
+	memcpy(args, argv, sizeof(argv));
+	args[2] = geometry;
+	argc = ARRLEN(argv) - 1;
+	if ((ctx = gfxctx_open(&argc, args)) == NULL)
+		errx(1, "gfxctx_open");
+
+	dash = dashboard_create(ctx, cols, rows);
+	if (dashboard_npanels(dash) != cols * rows) {
+		printf("\t%dx%d: %d panels\n", cols, rows,
+		    dashboard_npanels(dash));
+		return false;
+	}
+	for (row = 0; row < rows; row++) {
+		for (col = 0; col < cols; col++) {
+			p = dashboard_panel(dash, row * cols + col);
+			right = (col + 1 < cols) ?
+			    dashboard_panel(dash, row * cols + col + 1) : NULL;
+			below = (row + 1 < rows) ?
+			    dashboard_panel(dash, (row + 1) * cols + col) : NULL;
+			if ((col == 0 && p->px != 0) ||
+			    (row == 0 && p->py != 0) ||
+			    p->px + p->width + 1 !=
+			    ((right != NULL) ? right->px : width + 1) ||
+			    p->py + p->height + 1 !=
+			    ((below != NULL) ? below->py : height + 1) ||
+			    (right != NULL && right->py != p->py) ||
+			    (below != NULL && below->px != p->px)) {
+				printf("\t%dx%d in %dx%d: panel %d,%d at "
+				    "%d,%d size %dx%d\n", cols, rows, width,
+				    height, col, row, p->px, p->py, p->width,
+				    p->height);
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+/*
+ * test_layout: grids that divide the window evenly and grids that
+ * leave pixels over.
+ */
+static bool
+test_layout(void)
+{
+	return tiles(200, 100, 1, 1) &&
+	    tiles(201, 101, 2, 2) &&
+	    tiles(203, 101, 3, 2) &&
+	    tiles(100, 300, 1, 7) &&
+	    tiles(640, 480, 16, 16);
+}
+
+int
+main(int argc, char **argv)
+{
+	bool update;
+	size_t i, failed;
+
+	update = (argc == 2 && strcmp(argv[1], "-u") == 0);
+	if (argc > 1 && !update) {
+		fprintf(stderr, "Usage: %s [-u]\n", argv[0]);
+		return 1;
+	}
+
+	failed = 0;
+	for (i = 0; i < ARRLEN(checks); i++)
+		if (!run(&checks[i], update))
+			failed++;
+	for (i = 0; i < ARRLEN(tests); i++) {
+		if (tests[i].run())
+			printf("%-10s ok\n", tests[i].name);
+		else {
+			printf("%-10s FAIL\n", tests[i].name);
+			failed++;
+		}
+	}
+
+	if (failed > 0) {
+		printf("%zu of %zu failed\n", failed,
+		    ARRLEN(checks) + ARRLEN(tests));
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,272 @@
+/*
+ * Visualize graph on a gfxctx.h backend.
+ */
+
+#include "graphview.h"
+#include "graph.h"
+#include "gfxctx.h"
+#include "stats.h"
+#include "util.h"
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <err.h>
+#include <math.h>
+
+/*
+ * series_color: Colors of the series after the first one, which is
+ * drawn in the foreground color. Colors repeat if there are more
+ * series.
+ */
+static const char *series_color[] = {
+	"orange", "cyan", "magenta", "green",
+	"yellow", "blue", "red", "pink"
+};
+
+struct graphview
+{
+	struct graph *graph;
+	struct gfxwin *win;
+	struct gfxseg *seg;
+	size_t nseg;
+	int color[GRAPH_MAX_SERIES];	/* Allocated on first use */
+	size_t ncolor;
+	bool overlay;			/* Show stats in the corner */
+};
+
+#define OVERLAY_PAD	2
+
+static void
+graphview_draw(struct gfxwin *win);
+
+static void
+graphview_key(struct gfxwin *win, int key);
+
+static void
+draw_overlay(struct graphview *view);
+
+struct graphview*
+graphview_open(struct graph *graph, struct gfxctx *ctx)
+{
+	return graphview_open_in(graph,
+	    gfxwin_create(ctx, 0, 0, 640, 480, "white", NULL));
+}
+
+/*
+ * graphview_open_in: view graph in an existing window, such as a panel
+ * of a dashboard.
+ */
+struct graphview*
+graphview_open_in(struct graph *graph, struct gfxwin *win)
+{
+	struct graphview *view;
+
+	if ((view = malloc(sizeof(struct graphview))) == NULL)
+		err(1, "allocate graphview");
+
+	view->graph = graph;
+
+	view->win = win;
+	gfxwin_set_data(win, view);
+	gfxwin_set_draw_callback(win, graphview_draw);
+	gfxwin_set_key_callback(win, graphview_key);
+
+	view->seg = NULL;
+	view->nseg = 0;
+	view->color[0] = GFXWIN_FG;
+	view->ncolor = 1;
+	view->overlay = false;
+	return view;
+}
+
+void
+graphview_clear(struct graphview *view)
+{
+	gfxwin_clear(view->win, 0, 0, gfxwin_width(view->win),
+	    gfxwin_height(view->win));
+}
+
+/*
+ * graphview_columns: number of values that fit in the view.
+ */
+size_t
+graphview_columns(struct graphview *view)
+{
+	return gfxwin_width(view->win);
+}
+
+/*
+ * graphview_draw_values: draw n columns of each series, one column
+ * each. Arrays hold n + 1 values per series, series after series, the
+ * first being the column before the new ones or NAN if there is
+ * none. The graph is scrolled once by the number of new columns and
+ * the columns are drawn as one batch of segments per color.
+ *
+ * A single series is filled up to 'lo' and highlighted from there up
+ * to 'hi', more series are drawn as lines joined to the previous
+ * column. The first 'replace' columns redraw the rightmost columns
+ * already shown.
+ */
+void
+graphview_draw_values(struct graphview *view, const double *lo,
+    const double *hi, size_t nseries, size_t n, size_t replace)
+{
+	unsigned int height, width;
+	size_t i, k, nhl, skip, stride;
+	struct gfxwin *win;
+	struct gfxseg *seg, *hlseg;
+	double l, h;
+	int x, y;
+
+	win = view->win;
+	width = gfxwin_width(win);
+	height = gfxwin_height(win);
+
+	stride = n + 1;
+	skip = 0;
+	if (n > width) {
+		skip = n - width;
+		n = width;
+		replace = 0;
+	}
+	if (n == 0)
+		return;
+
+	if (2 * n > view->nseg) {
+		seg = realloc(view->seg, 2 * n * sizeof(struct gfxseg));
+		if (seg == NULL)
+			err(1, "allocate segments");
+		view->seg = seg;
+		view->nseg = 2 * n;
+	}
+
+	/*
+	 * Scroll graph to the left, discarding the leftmost pixels,
+	 * emptying n pixels on the right ready for new data.
+	 */
+	if (n > replace)
+		gfxwin_copy_area(win, n - replace, 0, width - (n - replace),
+		    height, 0, 0);
+	gfxwin_clear(win, width - n, 0, n, height);
+
+	/*
+	 * Draw new data to the rightmost pixels.
+	 */
+	if (nseries == 1) {
+		lo += skip + 1;
+		hi += skip + 1;
+		hlseg = &view->seg[n];
+		nhl = 0;
+		for (i = 0; i < n; i++) {
+			x = width - n + i;
+			seg = &view->seg[i];
+			seg->x1 = seg->x2 = x;
+			seg->y1 = y = height - round(height * lo[i]);
+			seg->y2 = height;
+			if (hi[i] > lo[i]) {
+				seg = &hlseg[nhl++];
+				seg->x1 = seg->x2 = x;
+				seg->y1 = height - round(height * hi[i]);
+				seg->y2 = y;
+			}
+		}
+		gfxwin_draw_segments(win, GFXWIN_FG, view->seg, n);
+		if (nhl > 0)
+			gfxwin_draw_segments(win, GFXWIN_HL, hlseg, nhl);
+		draw_overlay(view);
+		return;
+	}
+
+	for (; view->ncolor < nseries; view->ncolor++)
+		view->color[view->ncolor] = gfxwin_alloc_color(win,
+		    series_color[(view->ncolor - 1) % ARRLEN(series_color)]);
+
+	for (k = 0; k < nseries; k++) {
+		for (i = 0; i < n; i++) {
+			l = lo[k * stride + skip + i + 1];
+			h = hi[k * stride + skip + i + 1];
+
+			/*
+			 * Extend to the previous column to join the line.
+			 */
+			if (!isnan(lo[k * stride + skip + i])) {
+				l = MIN(l, hi[k * stride + skip + i]);
+				h = MAX(h, lo[k * stride + skip + i]);
+			}
+
+			seg = &view->seg[i];
+			seg->x1 = seg->x2 = width - n + i;
+			seg->y1 = (height - 1) - round((height - 1) * h);
+			seg->y2 = (height - 1) - round((height - 1) * l);
+		}
+		gfxwin_draw_segments(win, view->color[k], view->seg, n);
+	}
+	draw_overlay(view);
+}
+
+/*
+ * draw_overlay: stats in the top left corner. Scrolling moves the
+ * graph under the overlay to the left, where it stays hidden until it
+ * leaves the window, so redrawing the overlay on top is enough.
+ */
+static void
+draw_overlay(struct graphview *view)
+{
+	char buf[512], *line, *next;
+	int width, height, y;
+
+	if (!view->overlay)
+		return;
+
+	stats_format(buf, sizeof(buf));
+	height = gfxwin_textheight(view->win);
+	width = 0;
+	y = 0;
+	for (line = buf; *line != '\0'; line = next) {
+		next = strchr(line, '\n');
+		*next++ = '\0';
+		width = MAX(width, gfxwin_textwidth(view->win, line));
+		y += height;
+	}
+	gfxwin_clear(view->win, 0, 0, width + 2 * OVERLAY_PAD,
+	    y + 2 * OVERLAY_PAD);
+
+	y = OVERLAY_PAD;
+	for (line = buf; *line != '\0'; line += strlen(line) + 1) {
+		gfxwin_draw_text(view->win, OVERLAY_PAD, y, line);
+		y += height;
+	}
+}
+
+static void
+graphview_draw(struct gfxwin *win)
+{
+	struct graphview *view = gfxwin_data(win);
+
+	graph_refresh_view(view->graph);
+}
+
+/*
+ * graphview_key: '+' zooms in, '-' zooms out and 's' toggles the stats
+ * overlay.
+ */
+static void
+graphview_key(struct gfxwin *win, int key)
+{
+	struct graphview *view = gfxwin_data(win);
+
+	switch (key) {
+	case '+':
+	case '=':
+		graph_zoom(view->graph, -1);
+		break;
+	case '-':
+		graph_zoom(view->graph, 1);
+		break;
+	case 's':
+		view->overlay = !view->overlay;
+		graph_refresh_view(view->graph);
+		break;
+	}
+}
@@ -1,12 +1,18 @@
 #ifndef GRAPHVIEW_H
 #define GRAPHVIEW_H
 
+#include <stddef.h>
+
 struct gfxctx;
+struct gfxwin;
 struct graphview;
 struct graph;
 
-void graphview_draw_value(struct graphview *, double, double);
+void graphview_draw_values(struct graphview *, const double *,
+    const double *, size_t, size_t, size_t);
+size_t graphview_columns(struct graphview *);
 struct graphview* graphview_open(struct graph *, struct gfxctx *);
+struct graphview* graphview_open_in(struct graph *, struct gfxwin *);
 void graphview_clear(struct graphview *);
 
 #endif
@@ -0,0 +1,134 @@
+/*
+ * Line-framed input. Reads large chunks and splits them to complete
+ * lines, carrying a partial line over to the next read.
+ */
+
+#include "ingest.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <err.h>
+
+struct ingest
+{
+	int fd;
+	char *buf;			/* Aligned for any record */
+	size_t start;			/* Start of first unconsumed line */
+	size_t len;			/* End of valid data */
+	bool eof;
+};
+
+struct ingest*
+ingest_create(int fd)
+{
+	struct ingest *in;
+
+	if ((in = calloc(1, sizeof(struct ingest))) == NULL)
+		err(1, "allocate ingest");
+
+	/*
+	 * +1 for terminating a line.
+	 */
+	if ((in->buf = malloc(INGEST_BUFSZ + 1)) == NULL)
+		err(1, "allocate ingest buffer");
+
+	in->fd = fd;
+	return in;
+}
+
+int
+ingest_fd(struct ingest *in)
+{
+	return in->fd;
+}
+
+void
+ingest_free(struct ingest *in)
+{
+	free(in->buf);
+	free(in);
+}
+
+/*
+ * ingest_fill: read once from the input. Returns what read(2) returns.
+ * After this, complete lines are available from ingest_line().
+ */
+ssize_t
+ingest_fill(struct ingest *in)
+{
+	ssize_t n;
+
+	/*
+	 * Move partial line to the front to make room.
+	 */
+	if (in->start > 0) {
+		memmove(in->buf, &in->buf[in->start], in->len - in->start);
+		in->len -= in->start;
+		in->start = 0;
+	}
+
+	n = read(in->fd, &in->buf[in->len], INGEST_BUFSZ - in->len);
+	if (n > 0)
+		in->len += n;
+	else if (n == 0)
+		in->eof = true;
+
+	return n;
+}
+
+/*
+ * ingest_line: return next complete line without the line terminator,
+ * or NULL if there is none. The returned line is NUL-terminated and
+ * valid until the next ingest_fill().
+ */
+char*
+ingest_line(struct ingest *in, size_t *lenp)
+{
+	char *line, *nl;
+	size_t avail;
+
+	avail = in->len - in->start;
+	if (avail == 0)
+		return NULL;
+
+	line = &in->buf[in->start];
+	if ((nl = memchr(line, '\n', avail)) != NULL) {
+		*nl = '\0';
+		*lenp = nl - line;
+		in->start += *lenp + 1;
+	} else if (in->eof || (in->start == 0 && in->len == INGEST_BUFSZ)) {
+		/*
+		 * Last line without terminator, or a line that does not
+		 * fit in the buffer: pass as is.
+		 */
+		in->buf[in->len] = '\0';
+		*lenp = avail;
+		in->start = in->len;
+	} else
+		return NULL;
+
+	if (*lenp > 0 && line[*lenp - 1] == '\r')
+		line[--*lenp] = '\0';
+
+	return line;
+}
+
+/*
+ * ingest_records: return complete records of size recsz, which must
+ * divide INGEST_BUFSZ, and store their number to n. The records are
+ * aligned for any type and valid until the next ingest_fill(); a
+ * partial record is kept for the next read.
+ */
+void*
+ingest_records(struct ingest *in, size_t recsz, size_t *n)
+{
+	char *rec;
+
+	rec = &in->buf[in->start];
+	*n = (in->len - in->start) / recsz;
+	in->start += *n * recsz;
+
+	return (*n > 0) ? rec : NULL;
+}
@@ -0,0 +1,21 @@
+#ifndef INGEST_H
+#define INGEST_H
+
+#include <sys/types.h>
+
+/*
+ * INGEST_BUFSZ: Size of the read buffer. One read(2) per buffer, so
+ * this bounds the number of syscalls at high sample rates.
+ */
+#define INGEST_BUFSZ	65536
+
+struct ingest;
+
+struct ingest* ingest_create(int);
+ssize_t ingest_fill(struct ingest *);
+char* ingest_line(struct ingest *, size_t *);
+void* ingest_records(struct ingest *, size_t, size_t *);
+int ingest_fd(struct ingest *);
+void ingest_free(struct ingest *);
+
+#endif
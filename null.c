@@ -0,0 +1,487 @@
+/*
+ * gfxctx.h without a display: windows are framebuffers drawn with
+ * raster.c, and with -ppm every flushed frame is written to a file.
+ * For tests and benchmarks, so that they do not depend on a server.
+ */
+
+#include "util.h"
+#include "gfxctx.h"
+
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <libgen.h>
+#include <unistd.h>
+#include <limits.h>
+#include <time.h>
+#include <err.h>
+
+#include "null.h"
+
+/*
+ * Colors as in the X11 rgb.txt, enough for the defaults and the
+ * series. Others are given as #rrggbb.
+ */
+static const struct {
+	const char *name;
+	uint32_t rgb;
+} colors[] = {
+	{ "black",	0x000000 },
+	{ "white",	0xffffff },
+	{ "gray",	0xbebebe },
+	{ "grey",	0xbebebe },
+	{ "red",	0xff0000 },
+	{ "green",	0x00ff00 },
+	{ "blue",	0x0000ff },
+	{ "cyan",	0x00ffff },
+	{ "magenta",	0xff00ff },
+	{ "yellow",	0xffff00 },
+	{ "orange",	0xffa500 },
+	{ "pink",	0xffc0cb }
+};
+
+static uint32_t parse_color(const char *);
+static void parse_geometry(const char *, unsigned int *, unsigned int *);
+static void add_pixel(struct gfxwin *, uint32_t);
+static void write_frame(struct gfxctx *, struct gfxwin *);
+static struct gfxwin *to_parent(struct gfxwin *, int *, int *);
+static const struct gfxseg *to_parent_segments(struct gfxwin *,
+    const struct gfxseg *, size_t *);
+static int64_t now_ns(void);
+
+void
+gfxwin_clear(struct gfxwin *win,
+    int x, int y, unsigned int width, unsigned int height)
+{
+	win = to_parent(win, &x, &y);
+	raster_fill(&win->ras, x, y, width, height, win->bgpixel);
+	win->damaged = true;
+	win->ctx->requests++;
+}
+
+/*
+ * gfxctx_flush: a frame is done, write it out with -ppm.
+ */
+void
+gfxctx_flush(struct gfxctx *ctx)
+{
+	struct gfxwin *win;
+
+	for (win = ctx->wins; win != NULL; win = win->next) {
+		if (!win->damaged)
+			continue;
+		if (ctx->ppm != NULL)
+			write_frame(ctx, win);
+		win->damaged = false;
+		ctx->requests++;
+	}
+	if (ctx->first_frame == 0)
+		ctx->first_frame = now_ns() - ctx->t_open;
+}
+
+static void
+write_frame(struct gfxctx *ctx, struct gfxwin *win)
+{
+	char path[PATH_MAX];
+	FILE *fp;
+
+	snprintf(path, sizeof(path), "%s%06lu.ppm", ctx->ppm, ctx->frame++);
+	if ((fp = fopen(path, "w")) == NULL)
+		err(1, "%s", path);
+	null_write_ppm(ctx, fp);
+	if (fclose(fp) == EOF)
+		err(1, "%s", path);
+}
+
+void
+null_write_ppm(struct gfxctx *ctx, FILE *fp)
+{
+	struct gfxwin *win = ctx->wins;
+	uint32_t p;
+	int x, y;
+
+	fprintf(fp, "P6\n%d %d\n255\n", win->width, win->height);
+	for (y = 0; y < win->height; y++) {
+		for (x = 0; x < win->width; x++) {
+			p = win->ras.pix[y * win->ras.stride + x];
+			putc((p >> 16) & 0xff, fp);
+			putc((p >> 8) & 0xff, fp);
+			putc(p & 0xff, fp);
+		}
+	}
+	if (ferror(fp))
+		err(1, "write PPM");
+}
+
+unsigned long
+null_requests(struct gfxctx *ctx)
+{
+	return ctx->requests;
+}
+
+/*
+ * to_parent: window a panel draws to, with x and y moved there.
+ */
+static struct gfxwin *
+to_parent(struct gfxwin *win, int *x, int *y)
+{
+	if (win->parent == NULL)
+		return win;
+
+	*x += win->px;
+	*y += win->py;
+	return win->parent;
+}
+
+/*
+ * to_parent_segments: segments of a panel moved to its parent, cut to
+ * the panel, which is exact for the vertical and horizontal segments
+ * that are drawn. Segments outside the panel are dropped from n.
+ */
+static const struct gfxseg *
+to_parent_segments(struct gfxwin *win, const struct gfxseg *seg, size_t *n)
+{
+	struct gfxseg *t;
+	size_t i, m;
+	int w, h;
+
+	if (win->parent == NULL)
+		return seg;
+
+	if (*n > win->ntseg) {
+		if ((t = realloc(win->tseg, *n * sizeof(*t))) == NULL)
+			err(1, "realloc");
+		win->tseg = t;
+		win->ntseg = *n;
+	}
+	w = win->width - 1;
+	h = win->height - 1;
+	for (i = m = 0; i < *n; i++) {
+		if (MAX(seg[i].x1, seg[i].x2) < 0 ||
+		    MIN(seg[i].x1, seg[i].x2) > w ||
+		    MAX(seg[i].y1, seg[i].y2) < 0 ||
+		    MIN(seg[i].y1, seg[i].y2) > h)
+			continue;
+		t = &win->tseg[m++];
+		t->x1 = MAX(MIN(seg[i].x1, w), 0) + win->px;
+		t->y1 = MAX(MIN(seg[i].y1, h), 0) + win->py;
+		t->x2 = MAX(MIN(seg[i].x2, w), 0) + win->px;
+		t->y2 = MAX(MIN(seg[i].y2, h), 0) + win->py;
+	}
+	*n = m;
+	return win->tseg;
+}
+
+struct gfxwin*
+gfxwin_create_panel(struct gfxwin *parent, int x, int y, unsigned int width,
+    unsigned int height, void *data)
+{
+	struct gfxwin *win;
+
+	if (parent->parent != NULL)
+		errx(1, "panels are not nested");
+
+	if ((win = calloc(1, sizeof(struct gfxwin))) == NULL)
+		err(1, "calloc");
+	win->ctx = parent->ctx;
+	win->data = data;
+	win->parent = parent;
+	gfxwin_move_panel(win, x, y, width, height);
+
+	win->next_panel = parent->panels;
+	parent->panels = win;
+
+	return win;
+}
+
+void
+gfxwin_move_panel(struct gfxwin *win, int x, int y, unsigned int width,
+    unsigned int height)
+{
+	win->px = x;
+	win->py = y;
+	win->width = width;
+	win->height = height;
+}
+
+void*
+gfxwin_data(struct gfxwin *win)
+{
+	return win->data;
+}
+
+void
+gfxwin_set_data(struct gfxwin *win, void *data)
+{
+	win->data = data;
+}
+
+unsigned int
+gfxwin_height(struct gfxwin *win)
+{
+	return win->height;
+}
+
+/*
+ * gfxwin_textwidth: as if in the "fixed" font, 6 pixels a character.
+ */
+int
+gfxwin_textwidth(struct gfxwin *win, char *buf)
+{
+	return strlen(buf) * 6;
+}
+
+int
+gfxwin_textheight(struct gfxwin *win)
+{
+	return 13;
+}
+
+void
+gfxwin_draw_text(struct gfxwin *win, int x, int y, const char *s)
+{
+}
+
+unsigned int
+gfxwin_width(struct gfxwin *win)
+{
+	return win->width;
+}
+
+void
+gfxwin_set_draw_callback(struct gfxwin *win, void (*draw)(struct gfxwin *))
+{
+	win->draw = draw;
+}
+
+void
+gfxwin_set_key_callback(struct gfxwin *win, void (*key)(struct gfxwin *, int))
+{
+	win->key = key;
+}
+
+/*
+ * gfxwin_process_events: there are never any events.
+ */
+void
+gfxwin_process_events(struct gfxctx *ctx)
+{
+}
+
+bool
+gfxctx_pending(struct gfxctx *ctx)
+{
+	return false;
+}
+
+void
+gfxwin_draw_line(struct gfxwin *win, int x1, int y1, int x2, int y2)
+{
+	struct gfxseg seg;
+
+	if (win->parent != NULL) {
+		x2 += win->px;
+		y2 += win->py;
+	}
+	win = to_parent(win, &x1, &y1);
+	seg.x1 = x1;
+	seg.y1 = y1;
+	seg.x2 = x2;
+	seg.y2 = y2;
+	raster_segments(&win->ras, win->pixel[GFXWIN_FG], &seg, 1);
+	win->damaged = true;
+	win->ctx->requests++;
+}
+
+void
+gfxwin_draw_segments(struct gfxwin *win, int color, const struct gfxseg *seg,
+    size_t n)
+{
+	seg = to_parent_segments(win, seg, &n);
+	if (win->parent != NULL)
+		win = win->parent;
+	raster_segments(&win->ras, win->pixel[color], seg, n);
+	win->damaged = true;
+	win->ctx->requests++;
+}
+
+int
+gfxwin_alloc_color(struct gfxwin *win, const char *spec)
+{
+	if (win->parent != NULL)
+		win = win->parent;
+	add_pixel(win, parse_color(spec));
+
+	return win->npixel - 1;
+}
+
+void
+gfxwin_copy_area(struct gfxwin *win, int sx, int sy, unsigned int width,
+    unsigned int height, int dx, int dy)
+{
+	if (win->parent != NULL) {
+		sx += win->px;
+		sy += win->py;
+	}
+	win = to_parent(win, &dx, &dy);
+	raster_copy(&win->ras, sx, sy, width, height, dx, dy);
+	win->damaged = true;
+	win->ctx->requests++;
+}
+
+static uint32_t
+parse_color(const char *spec)
+{
+	char *end;
+	uint32_t rgb;
+	size_t i;
+
+	if (spec[0] == '#' && strlen(spec) == 7) {
+		rgb = strtoul(&spec[1], &end, 16);
+		if (*end == '\0')
+			return rgb;
+	}
+	for (i = 0; i < ARRLEN(colors); i++)
+		if (strcasecmp(spec, colors[i].name) == 0)
+			return colors[i].rgb;
+
+	errx(1, "couldn't parse color '%s'", spec);
+}
+
+static void
+add_pixel(struct gfxwin *win, uint32_t pixel)
+{
+	uint32_t *p;
+
+	if ((p = realloc(win->pixel, (win->npixel + 1) * sizeof(*p))) == NULL)
+		err(1, "realloc");
+	win->pixel = p;
+	win->pixel[win->npixel++] = pixel;
+}
+
+struct gfxwin*
+gfxwin_create(struct gfxctx *ctx, int _x, int _y, unsigned int _width,
+    unsigned int _height, const char *_bgspec, void *data)
+{
+	struct gfxwin *win;
+
+	if (ctx->geometry != NULL)
+		parse_geometry(ctx->geometry, &_width, &_height);
+
+	if ((win = calloc(1, sizeof(struct gfxwin))) == NULL)
+		err(1, "calloc");
+	win->width = _width;
+	win->height = _height;
+	win->ctx = ctx;
+	win->data = data;
+
+	win->bgpixel = parse_color((ctx->bgspec != NULL) ? ctx->bgspec :
+	    _bgspec);
+	add_pixel(win, parse_color((ctx->fgspec != NULL) ? ctx->fgspec :
+	    "black"));
+	add_pixel(win, parse_color((ctx->hlspec != NULL) ? ctx->hlspec :
+	    "red"));
+
+	win->ras.width = win->ras.stride = win->width;
+	win->ras.height = win->height;
+	if ((win->ras.pix = malloc((size_t) win->width * win->height *
+	    sizeof(uint32_t))) == NULL)
+		err(1, "allocate framebuffer");
+	raster_fill(&win->ras, 0, 0, win->width, win->height, win->bgpixel);
+
+	win->next = ctx->wins;
+	ctx->wins = win;
+
+	return win;
+}
+
+/*
+ * parse_geometry: only the size matters without a screen.
+ */
+static void
+parse_geometry(const char *s, unsigned int *width, unsigned int *height)
+{
+	unsigned int w, h;
+
+	if (sscanf(s, "%ux%u", &w, &h) == 2 && w > 0 && h > 0) {
+		*width = w;
+		*height = h;
+	}
+}
+
+int
+gfxctx_fd(struct gfxctx *ctx)
+{
+	return ctx->fd[0];
+}
+
+int64_t
+gfxctx_first_frame(struct gfxctx *ctx)
+{
+	return ctx->first_frame;
+}
+
+static int64_t
+now_ns(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) == -1)
+		err(1, "clock_gettime");
+
+	return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+struct gfxctx *
+gfxctx_open(int *argc, char **argv)
+{
+	static const char *optable[] = {
+		"-display", "-fg", "-bg", "-hl", "-font", "-geometry", "-ppm"
+	};
+	const char **optval[ARRLEN(optable)];
+	const char *ignored;
+	struct gfxctx *ctx;
+	size_t k;
+	int i, j;
+
+	if ((ctx = calloc(1, sizeof(struct gfxctx))) == NULL)
+		err(1, "calloc");
+	ctx->t_open = now_ns();
+
+	/*
+	 * The X11 options are accepted, so that the same command lines
+	 * work, but only colors and size are used.
+	 */
+	optval[0] = &ignored;
+	optval[1] = &ctx->fgspec;
+	optval[2] = &ctx->bgspec;
+	optval[3] = &ctx->hlspec;
+	optval[4] = &ignored;
+	optval[5] = &ctx->geometry;
+	optval[6] = &ctx->ppm;
+	for (i = j = 1; i < *argc; i++) {
+		for (k = 0; k < ARRLEN(optable); k++)
+			if (strcmp(argv[i], optable[k]) == 0)
+				break;
+		if (k < ARRLEN(optable) && i + 1 < *argc) {
+			*optval[k] = argv[i + 1];
+			i++;
+		} else if (strcmp(argv[i], "-raster") != 0)
+			argv[j++] = argv[i];
+	}
+	argv[j] = NULL;
+	*argc = j;
+
+	if (*argc != 1)
+		return NULL;
+
+	if ((ctx->name = basename(argv[0])) == NULL)
+		err(1, "basename");
+
+	if (pipe(ctx->fd) == -1)
+		err(1, "pipe");
+
+	return ctx;
+}
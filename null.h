@@ -0,0 +1,65 @@
+#ifndef NULL_H
+#define NULL_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "raster.h"
+
+struct gfxctx
+{
+	char *name;
+	const char *geometry;
+	const char *fgspec;
+	const char *bgspec;
+	const char *hlspec;
+	const char *ppm;	/* Prefix of frames written on flush */
+	unsigned long frame;
+	unsigned long requests;	/* As many as X11 would take */
+	struct gfxwin *wins;
+	int fd[2];		/* Never readable, for gfxctx_fd() */
+	int64_t t_open;		/* When gfxctx_open() was called */
+	int64_t first_frame;
+};
+
+struct gfxwin
+{
+	int width;
+	int height;
+	struct raster ras;
+	uint32_t bgpixel;
+	uint32_t *pixel;	/* By color, GFXWIN_FG first */
+	size_t npixel;
+	void (*draw)(struct gfxwin *win);
+	void (*key)(struct gfxwin *win, int key);
+	struct gfxctx *ctx;
+	void *data;
+	struct gfxwin *next;
+	bool damaged;
+
+	/*
+	 * A panel draws to its parent at px, py. Segments are moved
+	 * there in 'tseg'.
+	 */
+	struct gfxwin *parent;
+	int px, py;
+	struct gfxwin *panels;
+	struct gfxwin *next_panel;
+	struct gfxseg *tseg;
+	size_t ntseg;
+};
+
+/*
+ * null_write_ppm: write the latest window created as a binary PPM
+ * image.
+ */
+void null_write_ppm(struct gfxctx *, FILE *);
+
+/*
+ * null_requests: number of X11 requests the drawing so far would have
+ * taken, for benchmarks.
+ */
+unsigned long null_requests(struct gfxctx *);
+
+#endif
@@ -0,0 +1,128 @@
+/*
+ * numbench - compare numparse() against atof(3) and strtod(3)
+ */
+
+#include "numparse.h"
+#include "util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <err.h>
+
+#define NLINES	(1 << 20)
+#define ROUNDS	5
+
+static char *lines[NLINES];
+static size_t lens[NLINES];
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * Mix of what is typically piped in: counters, fractions and
+ * occasional exponents.
+ */
+static void
+make_lines(void)
+{
+	char buf[64];
+	size_t i;
+
+	srand(1);
+	for (i = 0; i < NLINES; i++) {
+		switch (i % 4) {
+		case 0:
+			snprintf(buf, sizeof(buf), "%d", rand());
+			break;
+		case 1:
+			snprintf(buf, sizeof(buf), "%.3f",
+			    rand() / (double) RAND_MAX * 100.0);
+			break;
+		case 2:
+			snprintf(buf, sizeof(buf), "%.6f",
+			    rand() / (double) RAND_MAX);
+			break;
+		case 3:
+			snprintf(buf, sizeof(buf), "%.4e",
+			    rand() / (double) RAND_MAX * 1e9);
+			break;
+		}
+		lens[i] = strlen(buf);
+		if ((lines[i] = strdup(buf)) == NULL)
+			err(1, "strdup");
+	}
+}
+
+static double
+run(const char *name, int which)
+{
+	double t0, best, sum, v;
+	size_t i, bad;
+	int r;
+
+	best = 0.0;
+	sum = 0.0;
+	bad = 0;
+	for (r = 0; r < ROUNDS; r++) {
+		t0 = now();
+		for (i = 0; i < NLINES; i++) {
+			switch (which) {
+			case 0:
+				if (numparse(lines[i], lines[i] + lens[i],
+				    &v) == NULL)
+					bad++;
+				break;
+			case 1:
+				v = atof(lines[i]);
+				break;
+			case 2:
+				v = strtod(lines[i], NULL);
+				break;
+			}
+			sum += v;
+		}
+		t0 = now() - t0;
+		if (r == 0 || t0 < best)
+			best = t0;
+	}
+	if (bad > 0)
+		errx(1, "%s: %zu malformed", name, bad);
+
+	printf("%-10s %8.1f ns/value %8.1f Mvalues/s (checksum %g)\n",
+	    name, best / NLINES * 1e9, NLINES / best / 1e6, sum);
+	return best;
+}
+
+int
+main(int argc, char **argv)
+{
+	double t_np, t_atof, t_strtod;
+	double a, b;
+	size_t i;
+
+	make_lines();
+
+	for (i = 0; i < NLINES; i++) {
+		numparse(lines[i], lines[i] + lens[i], &a);
+		b = strtod(lines[i], NULL);
+		if (a != b)
+			errx(1, "mismatch: '%s' %.17g != %.17g", lines[i],
+			    a, b);
+	}
+
+	t_np = run("numparse", 0);
+	t_atof = run("atof", 1);
+	t_strtod = run("strtod", 2);
+
+	printf("speedup vs atof %.2fx, vs strtod %.2fx\n",
+	    t_atof / t_np, t_strtod / t_np);
+	return 0;
+}
@@ -0,0 +1,327 @@
+/*
+ * Locale-free number parser for input data.
+ *
+ * Accepts [+-]digits[.digits][e[+-]digits][K|M|G|T], e.g. "12", "-0.5",
+ * "1.5e3" or "250M". Suffixes are decimal as in make_small().
+ *
+ * Timestamps are seconds since the Epoch with an optional fraction,
+ * e.g. "1621412345.25", or ISO-8601 date and time such as
+ * "2021-05-19T08:19:05.25Z" or "2021-05-19T11:19:05+03:00".
+ */
+
+#include "numparse.h"
+#include "util.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Powers of ten that are exact in a double.
+ */
+static const double pow10tab[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+#define NSEC			INT64_C(1000000000)
+#define DAY_SECS		(24 * 60 * 60)
+
+#define MAX_EXACT_MANTISSA	(UINT64_C(1) << 53)
+#define MAX_DIGITS		19
+
+static const char *digits(const char *, const char *, int, int *);
+static const char *fraction(const char *, const char *, int64_t *);
+static const char *isotime(const char *, const char *, int64_t *);
+static int64_t days_from_civil(int, int, int);
+
+static bool
+is_delim(char c)
+{
+	return c == ' ' || c == '\t' || c == ',' || c == '\r' || c == '\n' ||
+	    c == '\0';
+}
+
+/*
+ * numparse: parse number from s (up to end), skipping leading blanks.
+ * Returns pointer past the number or NULL if input is malformed, i.e.
+ * there is no number or it is not followed by a delimiter. The input
+ * must be NUL-terminated at or after end.
+ */
+const char*
+numparse(const char *s, const char *end, double *out)
+{
+	const char *p, *start;
+	uint64_t m;
+	int ndigits, nsig, exp10, e, esign;
+	bool neg, inexact;
+	double v;
+
+	while (s < end && (*s == ' ' || *s == '\t'))
+		s++;
+
+	p = start = s;
+	neg = false;
+	if (p < end && (*p == '-' || *p == '+'))
+		neg = (*p++ == '-');
+
+	m = 0;
+	ndigits = nsig = 0;
+	exp10 = 0;
+	inexact = false;
+	for (; p < end && *p >= '0' && *p <= '9'; p++, ndigits++) {
+		if (nsig < MAX_DIGITS) {
+			m = m * 10 + (*p - '0');
+			if (m != 0)
+				nsig++;
+		} else {
+			exp10++;
+			inexact |= (*p != '0');
+		}
+	}
+	if (p < end && *p == '.') {
+		p++;
+		for (; p < end && *p >= '0' && *p <= '9'; p++, ndigits++) {
+			if (nsig < MAX_DIGITS) {
+				m = m * 10 + (*p - '0');
+				if (m != 0)
+					nsig++;
+				exp10--;
+			} else
+				inexact |= (*p != '0');
+		}
+	}
+	if (ndigits == 0)
+		return NULL;
+
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		p++;
+		esign = 1;
+		if (p < end && (*p == '-' || *p == '+'))
+			esign = (*p++ == '-') ? -1 : 1;
+		if (p == end || *p < '0' || *p > '9')
+			return NULL;
+		for (e = 0; p < end && *p >= '0' && *p <= '9'; p++)
+			if (e < 10000)
+				e = e * 10 + (*p - '0');
+		exp10 += esign * e;
+	}
+
+	if (!inexact && m <= MAX_EXACT_MANTISSA &&
+	    exp10 >= -(int) (ARRLEN(pow10tab) - 1) &&
+	    exp10 <= (int) (ARRLEN(pow10tab) - 1)) {
+		/*
+		 * Exact mantissa and power of ten: a single correctly
+		 * rounded operation gives the correctly rounded result.
+		 */
+		v = (double) m;
+		if (exp10 < 0)
+			v /= pow10tab[-exp10];
+		else
+			v *= pow10tab[exp10];
+		if (neg)
+			v = -v;
+	} else {
+		/*
+		 * Rare: long mantissas or huge exponents. We never call
+		 * setlocale(3), so strtod(3) uses '.' in this program.
+		 */
+		v = strtod(start, NULL);
+	}
+
+	if (p < end) {
+		switch (*p) {
+		case 'k':
+		case 'K':
+			v *= 1e3;
+			p++;
+			break;
+		case 'M':
+			v *= 1e6;
+			p++;
+			break;
+		case 'G':
+			v *= 1e9;
+			p++;
+			break;
+		case 'T':
+			v *= 1e12;
+			p++;
+			break;
+		}
+	}
+
+	if (p < end && !is_delim(*p))
+		return NULL;
+
+	*out = v;
+	return p;
+}
+
+/*
+ * timeparse: parse timestamp from s (up to end) to nanoseconds since
+ * the Epoch, skipping leading blanks. Returns pointer past the
+ * timestamp or NULL if input is malformed.
+ */
+const char*
+timeparse(const char *s, const char *end, int64_t *out)
+{
+	const char *p;
+	int64_t secs, frac;
+
+	while (s < end && (*s == ' ' || *s == '\t'))
+		s++;
+
+	/*
+	 * ISO-8601 has a '-' after the year.
+	 */
+	if (end - s > 4 && s[4] == '-')
+		return isotime(s, end, out);
+
+	secs = 0;
+	for (p = s; p < end && *p >= '0' && *p <= '9'; p++) {
+		if (secs > INT64_MAX / NSEC / 10)
+			return NULL;
+		secs = secs * 10 + (*p - '0');
+	}
+	if (p == s)
+		return NULL;
+	if ((p = fraction(p, end, &frac)) == NULL)
+		return NULL;
+	if (p < end && !is_delim(*p))
+		return NULL;
+
+	*out = secs * NSEC + frac;
+	return p;
+}
+
+/*
+ * digits: parse exactly n digits.
+ */
+static const char *
+digits(const char *s, const char *end, int n, int *out)
+{
+	*out = 0;
+	for (; n > 0; n--, s++) {
+		if (s == end || *s < '0' || *s > '9')
+			return NULL;
+		*out = *out * 10 + (*s - '0');
+	}
+	return s;
+}
+
+/*
+ * fraction: parse optional fraction of a second to nanoseconds.
+ */
+static const char *
+fraction(const char *s, const char *end, int64_t *ns)
+{
+	int64_t scale;
+
+	*ns = 0;
+	if (s == end || *s != '.')
+		return s;
+
+	s++;
+	for (scale = NSEC / 10; s < end && *s >= '0' && *s <= '9'; s++) {
+		*ns += (*s - '0') * scale;
+		scale /= 10;
+	}
+	return s;
+}
+
+/*
+ * isotime: YYYY-MM-DDThh:mm[:ss[.frac]][Z|+hh[:mm]|-hh[:mm]]. Without
+ * a zone the time is local time.
+ */
+static const char *
+isotime(const char *s, const char *end, int64_t *out)
+{
+	static int64_t last_hourkey, last_hour;
+	static bool have_last;
+	int year, mon, mday, hour, min, sec, oh, om, sign;
+	int64_t frac, secs, hourkey;
+	struct tm tm;
+	time_t t;
+
+	if ((s = digits(s, end, 4, &year)) == NULL || s == end || *s++ != '-' ||
+	    (s = digits(s, end, 2, &mon)) == NULL || s == end || *s++ != '-' ||
+	    (s = digits(s, end, 2, &mday)) == NULL || s == end || *s++ != 'T' ||
+	    (s = digits(s, end, 2, &hour)) == NULL || s == end || *s++ != ':' ||
+	    (s = digits(s, end, 2, &min)) == NULL)
+		return NULL;
+
+	sec = 0;
+	frac = 0;
+	if (s < end && *s == ':') {
+		if ((s = digits(s + 1, end, 2, &sec)) == NULL ||
+		    (s = fraction(s, end, &frac)) == NULL)
+			return NULL;
+	}
+	if (mon < 1 || mon > 12 || mday < 1 || mday > 31 || hour > 23 ||
+	    min > 59 || sec > 60)
+		return NULL;
+
+	secs = days_from_civil(year, mon, mday) * DAY_SECS + hour * 60 * 60 +
+	    min * 60 + sec;
+
+	if (s < end && *s == 'Z')
+		s++;
+	else if (s < end && (*s == '+' || *s == '-')) {
+		sign = (*s == '-') ? -1 : 1;
+		om = 0;
+		if ((s = digits(s + 1, end, 2, &oh)) == NULL)
+			return NULL;
+		if (s < end && *s == ':')
+			s++;
+		if (s < end && *s >= '0' && *s <= '9' &&
+		    (s = digits(s, end, 2, &om)) == NULL)
+			return NULL;
+		secs -= sign * (oh * 60 * 60 + om * 60);
+	} else {
+		/*
+		 * Local time: mktime(3) once per hour of input, as the
+		 * UTC offset changes only on an hour boundary.
+		 */
+		hourkey = secs - min * 60 - sec;
+		if (!have_last || hourkey != last_hourkey) {
+			memset(&tm, 0, sizeof(tm));
+			tm.tm_year = year - 1900;
+			tm.tm_mon = mon - 1;
+			tm.tm_mday = mday;
+			tm.tm_hour = hour;
+			tm.tm_isdst = -1;
+			if ((t = mktime(&tm)) == (time_t) -1)
+				return NULL;
+			last_hourkey = hourkey;
+			last_hour = t;
+			have_last = true;
+		}
+		secs = last_hour + min * 60 + sec;
+	}
+	if (s < end && !is_delim(*s))
+		return NULL;
+
+	*out = secs * NSEC + frac;
+	return s;
+}
+
+/*
+ * days_from_civil: days since 1970-01-01 of a proleptic Gregorian date.
+ */
+static int64_t
+days_from_civil(int y, int m, int d)
+{
+	int64_t era;
+	int yoe, doy, doe;
+
+	y -= (m <= 2);
+	era = (y >= 0 ? y : y - 399) / 400;
+	yoe = y - era * 400;
+	doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+	doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+	return era * 146097 + doe - 719468;
+}
@@ -0,0 +1,9 @@
+#ifndef NUMPARSE_H
+#define NUMPARSE_H
+
+#include <stdint.h>
+
+const char* numparse(const char *, const char *, double *);
+const char* timeparse(const char *, const char *, int64_t *);
+
+#endif
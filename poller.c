@@ -0,0 +1,270 @@
+/*
+ * Readiness of many descriptors without rebuilding the set on every
+ * wait: epoll(7) on Linux, poll(2) elsewhere. On Linux timeouts are
+ * kept by a timerfd, to the nanosecond rather than rounded up to the
+ * millisecond.
+ */
+
+#include "poller.h"
+#include "util.h"
+
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <err.h>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#else
+#include <poll.h>
+#endif
+
+#ifdef __linux__
+static void set_timer(struct poller *, int64_t);
+#endif
+
+/*
+ * POLLER_MAXEVENTS: Maximum number of descriptors reported by one
+ * wait, the rest are reported by the next one.
+ */
+#define POLLER_MAXEVENTS 64
+
+/*
+ * POLLER_SLACK: How much earlier than asked the timer may expire, so
+ * that it is not set again on every wait for the same deadline.
+ */
+#define POLLER_SLACK 50000
+
+struct poller
+{
+#ifdef __linux__
+	int epfd;
+	struct epoll_event ev[POLLER_MAXEVENTS];
+	int tfd;
+	int64_t deadline;	/* Of the timer, 0 if not set */
+
+	/*
+	 * Regular files, which epoll refuses and which are always
+	 * readable.
+	 */
+	int *filefd;
+	void **filedata;
+	size_t nfile;
+	size_t filecap;
+#else
+	struct pollfd *fds;
+	void **data;
+	size_t nfd;
+	size_t cap;
+	size_t next;		/* Where to start looking on next wait */
+#endif
+};
+
+struct poller*
+poller_create(void)
+{
+	struct poller *p;
+
+	if ((p = calloc(1, sizeof(struct poller))) == NULL)
+		err(1, "allocate poller");
+
+#ifdef __linux__
+	struct epoll_event ev;
+
+	if ((p->epfd = epoll_create1(EPOLL_CLOEXEC)) == -1)
+		err(1, "epoll_create1");
+	if ((p->tfd = timerfd_create(CLOCK_MONOTONIC,
+	    TFD_NONBLOCK | TFD_CLOEXEC)) == -1)
+		err(1, "timerfd_create");
+	ev.events = EPOLLIN;
+	ev.data.ptr = &p->tfd;
+	if (epoll_ctl(p->epfd, EPOLL_CTL_ADD, p->tfd, &ev) == -1)
+		err(1, "epoll_ctl");
+#endif
+	return p;
+}
+
+/*
+ * poller_add: wait for fd to become readable, reported with data.
+ */
+void
+poller_add(struct poller *p, int fd, void *data)
+{
+#ifdef __linux__
+	struct epoll_event ev;
+
+	int *fds;
+	void **d;
+
+	ev.events = EPOLLIN;
+	ev.data.ptr = data;
+	if (epoll_ctl(p->epfd, EPOLL_CTL_ADD, fd, &ev) == 0)
+		return;
+	if (errno != EPERM)
+		err(1, "epoll_ctl");
+
+	if (p->nfile == p->filecap) {
+		p->filecap = (p->filecap == 0) ? 8 : p->filecap * 2;
+		fds = realloc(p->filefd, p->filecap * sizeof(int));
+		d = realloc(p->filedata, p->filecap * sizeof(void *));
+		if (fds == NULL || d == NULL)
+			err(1, "allocate poller");
+		p->filefd = fds;
+		p->filedata = d;
+	}
+	p->filefd[p->nfile] = fd;
+	p->filedata[p->nfile] = data;
+	p->nfile++;
+#else
+	struct pollfd *fds;
+	void **d;
+
+	if (p->nfd == p->cap) {
+		p->cap = (p->cap == 0) ? 8 : p->cap * 2;
+		fds = realloc(p->fds, p->cap * sizeof(struct pollfd));
+		d = realloc(p->data, p->cap * sizeof(void *));
+		if (fds == NULL || d == NULL)
+			err(1, "allocate poller");
+		p->fds = fds;
+		p->data = d;
+	}
+	p->fds[p->nfd].fd = fd;
+	p->fds[p->nfd].events = POLLIN;
+	p->data[p->nfd] = data;
+	p->nfd++;
+#endif
+}
+
+/*
+ * poller_del: stop waiting for fd, which must be done before closing
+ * it.
+ */
+void
+poller_del(struct poller *p, int fd)
+{
+#ifdef __linux__
+	struct epoll_event ev;
+	size_t i;
+
+	for (i = 0; i < p->nfile; i++)
+		if (p->filefd[i] == fd) {
+			p->nfile--;
+			p->filefd[i] = p->filefd[p->nfile];
+			p->filedata[i] = p->filedata[p->nfile];
+			return;
+		}
+
+	if (epoll_ctl(p->epfd, EPOLL_CTL_DEL, fd, &ev) == -1)
+		err(1, "epoll_ctl");
+#else
+	size_t i;
+
+	for (i = 0; i < p->nfd; i++)
+		if (p->fds[i].fd == fd)
+			break;
+	if (i == p->nfd)
+		return;
+
+	p->nfd--;
+	p->fds[i] = p->fds[p->nfd];
+	p->data[i] = p->data[p->nfd];
+#endif
+}
+
+/*
+ * poller_wait: wait up to timeout nanoseconds, or forever if negative,
+ * and store data of at most n readable descriptors to ready. Returns
+ * the number stored, or -1 with errno set.
+ */
+int
+poller_wait(struct poller *p, void **ready, int n, int64_t timeout)
+{
+	int ms, nready, i;
+	size_t j;
+#ifdef __linux__
+	uint64_t expirations;
+#else
+	size_t k;
+#endif
+
+	/*
+	 * Round up, a wakeup before the deadline would only spin.
+	 */
+	if (timeout < 0)
+		ms = -1;
+	else
+		ms = (timeout + 999999) / 1000000;
+
+#ifdef __linux__
+	if (timeout > 0 && p->nfile == 0) {
+		set_timer(p, timeout);
+		ms = -1;
+	}
+	if (p->nfile > 0)
+		ms = 0;
+	nready = epoll_wait(p->epfd, p->ev, MIN(n, POLLER_MAXEVENTS), ms);
+	if (nready == -1)
+		return -1;
+	for (i = j = 0; i < nready; i++) {
+		if (p->ev[i].data.ptr == &p->tfd) {
+			if (read(p->tfd, &expirations,
+			    sizeof(expirations)) == -1 && errno != EAGAIN)
+				err(1, "read timer");
+			p->deadline = 0;
+			continue;
+		}
+		ready[j++] = p->ev[i].data.ptr;
+	}
+	nready = j;
+	for (j = 0; j < p->nfile && nready < n; j++)
+		ready[nready++] = p->filedata[j];
+#else
+	if ((nready = poll(p->fds, p->nfd, ms)) <= 0)
+		return nready;
+
+	/*
+	 * Start where the previous wait stopped so that every
+	 * descriptor gets its turn.
+	 */
+	i = 0;
+	for (k = 0; k < p->nfd && i < n; k++) {
+		j = (p->next + k) % p->nfd;
+		if (p->fds[j].revents != 0)
+			ready[i++] = p->data[j];
+	}
+	p->next = (p->next + k) % p->nfd;
+	nready = i;
+#endif
+	return nready;
+}
+
+#ifdef __linux__
+/*
+ * set_timer: expire in timeout nanoseconds, unless already set to
+ * expire a little before that. A timer left over from a previous wait
+ * only causes a wakeup with nothing ready.
+ */
+static void
+set_timer(struct poller *p, int64_t timeout)
+{
+	struct itimerspec its;
+	struct timespec now;
+	int64_t deadline;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &now) == -1)
+		err(1, "clock_gettime");
+	deadline = (int64_t) now.tv_sec * 1000000000 + now.tv_nsec + timeout;
+	if (p->deadline != 0 && p->deadline <= deadline &&
+	    p->deadline > deadline - POLLER_SLACK)
+		return;
+
+	its.it_interval.tv_sec = its.it_interval.tv_nsec = 0;
+	its.it_value.tv_sec = deadline / 1000000000;
+	its.it_value.tv_nsec = deadline % 1000000000;
+	if (timerfd_settime(p->tfd, TFD_TIMER_ABSTIME, &its, NULL) == -1)
+		err(1, "timerfd_settime");
+	p->deadline = deadline;
+}
+#endif
@@ -0,0 +1,13 @@
+#ifndef POLLER_H
+#define POLLER_H
+
+#include <stdint.h>
+
+struct poller;
+
+struct poller* poller_create(void);
+void poller_add(struct poller *, int, void *);
+void poller_del(struct poller *, int);
+int poller_wait(struct poller *, void **, int, int64_t);
+
+#endif
@@ -0,0 +1,233 @@
+/*
+ * Built-in sources read from /proc: the file is kept open and read
+ * from the start with pread(2) on every sample, only the line and
+ * field wanted are parsed and counters are turned into rates here.
+ *
+ *	netdev:<interface>:rx|tx	bytes per second
+ *	cpu[:<n>]			percentage busy, of all or CPU n
+ *	loadavg[:1|5|15]		load average
+ *	meminfo:<field>			bytes, e.g. meminfo:MemAvailable
+ */
+
+#include "procsrc.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <err.h>
+
+/*
+ * PROCSRC_BUFSZ: Size of the read buffer, shared by all sources.
+ * Fields past it are not found, which is some hundred interfaces into
+ * /proc/net/dev.
+ */
+#define PROCSRC_BUFSZ	65536
+
+#define SRC_NETDEV	0
+#define SRC_CPU		1
+#define SRC_LOADAVG	2
+#define SRC_MEMINFO	3
+
+/*
+ * NETDEV_TX: Field of transmitted bytes, after the eight receive
+ * fields.
+ */
+#define NETDEV_TX	8
+
+/*
+ * CPU_FIELDS: user, nice, system, idle, iowait, irq, softirq and
+ * steal. Guest time is already counted in user and nice.
+ */
+#define CPU_FIELDS	8
+
+struct procsrc
+{
+	int kind;
+	int fd;
+	char key[64];		/* Start of the line wanted */
+	int field;		/* Number on the line, from 0 */
+	bool have_last;		/* Previous sample of a rate */
+	uint64_t last;
+	uint64_t last_idle;
+	int64_t last_t;
+};
+
+static char buf[PROCSRC_BUFSZ];
+
+static const char *find_line(const char *, const char *);
+static const char *skip_fields(const char *, int);
+
+struct procsrc*
+procsrc_open(const char *spec)
+{
+	struct procsrc *src;
+	const char *path, *arg, *dir;
+	char *end;
+	long n;
+
+	if ((src = calloc(1, sizeof(struct procsrc))) == NULL)
+		err(1, "allocate source");
+
+	arg = strchr(spec, ':');
+	if (strncmp(spec, "netdev:", 7) == 0 &&
+	    (dir = strrchr(arg, ':')) != arg && dir - arg - 1 <
+	    (int) sizeof(src->key) - 1) {
+		src->kind = SRC_NETDEV;
+		path = "/proc/net/dev";
+		snprintf(src->key, sizeof(src->key), "%.*s:",
+		    (int) (dir - arg - 1), arg + 1);
+		if (strcmp(dir, ":rx") == 0)
+			src->field = 0;
+		else if (strcmp(dir, ":tx") == 0)
+			src->field = NETDEV_TX;
+		else
+			errx(1, "%s: not rx or tx", spec);
+	} else if (strcmp(spec, "cpu") == 0 || strncmp(spec, "cpu:", 4) == 0) {
+		src->kind = SRC_CPU;
+		path = "/proc/stat";
+		strcpy(src->key, "cpu ");
+		if (arg != NULL) {
+			n = strtol(arg + 1, &end, 10);
+			if (arg[1] == '\0' || *end != '\0' || n < 0 ||
+			    n > 1000000)
+				errx(1, "%s: invalid CPU", spec);
+			snprintf(src->key, sizeof(src->key), "cpu%ld ", n);
+		}
+	} else if (strcmp(spec, "loadavg") == 0 ||
+	    strncmp(spec, "loadavg:", 8) == 0) {
+		src->kind = SRC_LOADAVG;
+		path = "/proc/loadavg";
+		if (arg == NULL || strcmp(arg, ":1") == 0)
+			src->field = 0;
+		else if (strcmp(arg, ":5") == 0)
+			src->field = 1;
+		else if (strcmp(arg, ":15") == 0)
+			src->field = 2;
+		else
+			errx(1, "%s: not 1, 5 or 15 minutes", spec);
+	} else if (strncmp(spec, "meminfo:", 8) == 0 && arg[1] != '\0' &&
+	    strlen(arg) < sizeof(src->key) - 1) {
+		src->kind = SRC_MEMINFO;
+		path = "/proc/meminfo";
+		snprintf(src->key, sizeof(src->key), "%s:", arg + 1);
+	} else
+		errx(1, "%s: unknown source", spec);
+
+	if ((src->fd = open(path, O_RDONLY | O_CLOEXEC)) == -1)
+		err(1, "%s", path);
+
+	return src;
+}
+
+/*
+ * procsrc_read: sample src at monotonic time t in nanoseconds. Returns
+ * false if there is no value, such as on the first sample of a rate or
+ * when a counter was reset.
+ */
+bool
+procsrc_read(struct procsrc *src, int64_t t, double *v)
+{
+	uint64_t cur, idle, x;
+	const char *p;
+	char *end;
+	ssize_t n;
+	int i;
+	bool ok;
+
+	if ((n = pread(src->fd, buf, sizeof(buf) - 1, 0)) == -1)
+		err(1, "read source");
+	buf[n] = '\0';
+
+	p = buf;
+	if (src->kind != SRC_LOADAVG &&
+	    (p = find_line(buf, src->key)) == NULL)
+		return false;
+	if ((p = skip_fields(p, src->field)) == NULL)
+		return false;
+
+	switch (src->kind) {
+	case SRC_LOADAVG:
+		*v = strtod(p, &end);
+		return end != p;
+	case SRC_MEMINFO:
+		cur = strtoull(p, &end, 10);
+		if (end == p)
+			return false;
+		*v = (strncmp(end, " kB", 3) == 0) ? cur * 1024.0 : cur;
+		return true;
+	}
+
+	/*
+	 * Rates of counters.
+	 */
+	cur = idle = 0;
+	for (i = 0; i < ((src->kind == SRC_CPU) ? CPU_FIELDS : 1); i++) {
+		x = strtoull(p, &end, 10);
+		if (end == p)
+			break;
+		cur += x;
+		if (i == 3 || i == 4)
+			idle += x;
+		p = end;
+	}
+	if (i == 0)
+		return false;
+
+	ok = src->have_last && cur >= src->last && idle >= src->last_idle &&
+	    t > src->last_t;
+	if (ok && src->kind == SRC_CPU) {
+		if ((ok = (cur > src->last)))
+			*v = 100.0 * ((cur - src->last) - (idle - src->last_idle)) /
+			    (cur - src->last);
+	} else if (ok)
+		*v = (cur - src->last) / ((t - src->last_t) / 1e9);
+
+	src->have_last = true;
+	src->last = cur;
+	src->last_idle = idle;
+	src->last_t = t;
+
+	return ok;
+}
+
+/*
+ * find_line: past key at the start of a line, leading blanks ignored.
+ */
+static const char *
+find_line(const char *p, const char *key)
+{
+	size_t len;
+
+	len = strlen(key);
+	while (*p != '\0') {
+		while (*p == ' ')
+			p++;
+		if (strncmp(p, key, len) == 0)
+			return p + len;
+		if ((p = strchr(p, '\n')) == NULL)
+			return NULL;
+		p++;
+	}
+
+	return NULL;
+}
+
+/*
+ * skip_fields: start of the n'th blank separated field from p.
+ */
+static const char *
+skip_fields(const char *p, int n)
+{
+	for (;;) {
+		while (*p == ' ' || *p == '\t')
+			p++;
+		if (*p == '\0' || *p == '\n')
+			return NULL;
+		if (n-- == 0)
+			return p;
+		while (*p != ' ' && *p != '\t' && *p != '\0' && *p != '\n')
+			p++;
+	}
+}
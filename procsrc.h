@@ -0,0 +1,12 @@
+#ifndef PROCSRC_H
+#define PROCSRC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct procsrc;
+
+struct procsrc* procsrc_open(const char *);
+bool procsrc_read(struct procsrc *, int64_t, double *);
+
+#endif
@@ -0,0 +1,88 @@
+/*
+ * Lock-free single-producer single-consumer queue between the ingest
+ * thread and the drawing thread, laid out like the ring in xrtshm.c.
+ */
+
+#include "queue.h"
+
+#include <stdlib.h>
+#include <err.h>
+
+struct queue
+{
+	struct queue_entry *entry;
+	uint64_t mask;
+	char pad1[48];
+	uint64_t head;		/* Written by producer only */
+	char pad2[56];
+	uint64_t tail;		/* Written by consumer only */
+	char pad3[56];
+};
+
+/*
+ * queue_create: allocate queue of at least n entries.
+ */
+struct queue*
+queue_create(size_t n)
+{
+	struct queue *q;
+	size_t size;
+
+	for (size = 1; size < n; size *= 2)
+		;
+
+	if ((q = calloc(1, sizeof(struct queue))) == NULL ||
+	    (q->entry = calloc(size, sizeof(struct queue_entry))) == NULL)
+		err(1, "allocate queue");
+	q->mask = size - 1;
+
+	return q;
+}
+
+/*
+ * queue_push: add all n entries, or none if they do not fit. Returns
+ * false if the queue is too full.
+ */
+bool
+queue_push(struct queue *q, const struct queue_entry *e, size_t n)
+{
+	uint64_t head, i;
+
+	head = q->head;
+	if (head - __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE) + n >
+	    q->mask + 1)
+		return false;
+
+	for (i = 0; i < n; i++)
+		q->entry[(head + i) & q->mask] = e[i];
+	__atomic_store_n(&q->head, head + n, __ATOMIC_RELEASE);
+	return true;
+}
+
+/*
+ * queue_pop: take at most n entries. Returns the number taken.
+ */
+size_t
+queue_pop(struct queue *q, struct queue_entry *e, size_t n)
+{
+	uint64_t head, tail, i;
+
+	tail = q->tail;
+	head = __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+	if (head - tail < n)
+		n = head - tail;
+
+	for (i = 0; i < n; i++)
+		e[i] = q->entry[(tail + i) & q->mask];
+	__atomic_store_n(&q->tail, tail + n, __ATOMIC_RELEASE);
+	return n;
+}
+
+/*
+ * queue_length: number of entries waiting, for the consumer.
+ */
+size_t
+queue_length(struct queue *q)
+{
+	return __atomic_load_n(&q->head, __ATOMIC_ACQUIRE) - q->tail;
+}
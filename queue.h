@@ -0,0 +1,28 @@
+#ifndef QUEUE_H
+#define QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * queue_entry: value of a series, or with series -1 a value of a row
+ * of series from 0 on, the first of which has the number of values in
+ * the row in 'n'.
+ */
+struct queue_entry
+{
+	int64_t time;
+	int32_t series;
+	uint32_t n;
+	double value;
+};
+
+struct queue;
+
+struct queue* queue_create(size_t);
+bool queue_push(struct queue *, const struct queue_entry *, size_t);
+size_t queue_pop(struct queue *, struct queue_entry *, size_t);
+size_t queue_length(struct queue *);
+
+#endif
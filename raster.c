@@ -0,0 +1,155 @@
+/*
+ * Software rasterizer: what the graph draws, i.e. filled rectangles,
+ * segments and scrolling, with plain loops over rows of pixels. Every
+ * operation is clipped to the framebuffer.
+ */
+
+#include "raster.h"
+#include "gfxctx.h"
+#include "util.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static int clip(int *, int *, int);
+static void line(struct raster *, uint32_t, int, int, int, int);
+
+/*
+ * clip: clip range [*a, *b) to [0, max). Returns 0 if nothing is left.
+ */
+static int
+clip(int *a, int *b, int max)
+{
+	*a = MAX(*a, 0);
+	*b = MIN(*b, max);
+	return *a < *b;
+}
+
+void
+raster_fill(struct raster *r, int x, int y, unsigned int width,
+    unsigned int height, uint32_t c)
+{
+	int x2, y2, i;
+	uint32_t *p;
+
+	x2 = x + (int) width;
+	y2 = y + (int) height;
+	if (!clip(&x, &x2, r->width) || !clip(&y, &y2, r->height))
+		return;
+
+	for (; y < y2; y++) {
+		p = &r->pix[(size_t) y * r->stride + x];
+		for (i = 0; i < x2 - x; i++)
+			p[i] = c;
+	}
+}
+
+/*
+ * raster_segments: draw segments including both end points, like
+ * XDrawSegments(3) with thin lines. Vertical ones, which is what the
+ * graph mostly draws, take a fast path.
+ */
+void
+raster_segments(struct raster *r, uint32_t c, const struct gfxseg *seg,
+    size_t n)
+{
+	int x, y1, y2;
+	uint32_t *p;
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		x = seg[i].x1;
+		if (x != seg[i].x2) {
+			line(r, c, seg[i].x1, seg[i].y1, seg[i].x2, seg[i].y2);
+			continue;
+		}
+		if (x < 0 || x >= r->width)
+			continue;
+		y1 = MIN(seg[i].y1, seg[i].y2);
+		y2 = MAX(seg[i].y1, seg[i].y2) + 1;
+		if (!clip(&y1, &y2, r->height))
+			continue;
+		for (p = &r->pix[(size_t) y1 * r->stride + x]; y1 < y2; y1++) {
+			*p = c;
+			p += r->stride;
+		}
+	}
+}
+
+/*
+ * line: Bresenham for the rare segment that is not vertical.
+ */
+static void
+line(struct raster *r, uint32_t c, int x1, int y1, int x2, int y2)
+{
+	int dx, dy, sx, sy, e, e2;
+
+	dx = abs(x2 - x1);
+	dy = -abs(y2 - y1);
+	sx = (x1 < x2) ? 1 : -1;
+	sy = (y1 < y2) ? 1 : -1;
+	e = dx + dy;
+	for (;;) {
+		if (x1 >= 0 && x1 < r->width && y1 >= 0 && y1 < r->height)
+			r->pix[(size_t) y1 * r->stride + x1] = c;
+		if (x1 == x2 && y1 == y2)
+			break;
+		e2 = 2 * e;
+		if (e2 >= dy) {
+			e += dy;
+			x1 += sx;
+		}
+		if (e2 <= dx) {
+			e += dx;
+			y1 += sy;
+		}
+	}
+}
+
+/*
+ * raster_copy: copy area, which may overlap the destination, e.g. for
+ * scrolling.
+ */
+void
+raster_copy(struct raster *r, int sx, int sy, unsigned int width,
+    unsigned int height, int dx, int dy)
+{
+	int w, h, i, row;
+
+	/*
+	 * Clip both rectangles, keeping them the same size.
+	 */
+	w = width;
+	h = height;
+	if (sx < 0) {
+		w += sx;
+		dx -= sx;
+		sx = 0;
+	}
+	if (sy < 0) {
+		h += sy;
+		dy -= sy;
+		sy = 0;
+	}
+	if (dx < 0) {
+		w += dx;
+		sx -= dx;
+		dx = 0;
+	}
+	if (dy < 0) {
+		h += dy;
+		sy -= dy;
+		dy = 0;
+	}
+	w = MIN(w, MIN(r->width - sx, r->width - dx));
+	h = MIN(h, MIN(r->height - sy, r->height - dy));
+	if (w <= 0 || h <= 0)
+		return;
+
+	for (i = 0; i < h; i++) {
+		row = (dy > sy) ? h - 1 - i : i;
+		memmove(&r->pix[(size_t) (dy + row) * r->stride + dx],
+		    &r->pix[(size_t) (sy + row) * r->stride + sx],
+		    w * sizeof(uint32_t));
+	}
+}
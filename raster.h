@@ -0,0 +1,28 @@
+#ifndef RASTER_H
+#define RASTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct gfxseg;
+
+/*
+ * raster: framebuffer in client memory, 32 bits per pixel, 'stride'
+ * pixels per row.
+ */
+struct raster
+{
+	uint32_t *pix;
+	int width;
+	int height;
+	int stride;
+};
+
+void raster_fill(struct raster *, int, int, unsigned int, unsigned int,
+    uint32_t);
+void raster_segments(struct raster *, uint32_t, const struct gfxseg *,
+    size_t);
+void raster_copy(struct raster *, int, int, unsigned int, unsigned int, int,
+    int);
+
+#endif
@@ -0,0 +1,88 @@
+/*
+ * Counters for seeing whether xrtgraph keeps up, shown in the overlay
+ * and dumped on SIGUSR1 or to the -stats socket.
+ */
+
+#include "stats.h"
+
+#include <stdio.h>
+#include <time.h>
+#include <err.h>
+
+#define RATE_NS		INT64_C(1000000000)	/* Rate over a second */
+
+struct stats stats;
+
+static uint64_t prev_lines;
+static int64_t prev_t;
+
+#define LOAD(_field)	__atomic_load_n(&stats._field, __ATOMIC_RELAXED)
+
+static int64_t
+now_ns(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) == -1)
+		err(1, "clock_gettime");
+
+	return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*
+ * stats_init: start measuring the input rate.
+ */
+void
+stats_init(void)
+{
+	prev_lines = LOAD(lines);
+	prev_t = now_ns();
+}
+
+/*
+ * stats_format: counters as lines of name and value, with the input
+ * rate over the latest second or more. Returns the length as
+ * snprintf(3) does.
+ */
+size_t
+stats_format(char *buf, size_t len)
+{
+	static double rate;
+	uint64_t lines;
+	int64_t t;
+	int n;
+
+	t = now_ns();
+	lines = LOAD(lines);
+	if (prev_t == 0)
+		stats_init();
+	else if (t - prev_t >= RATE_NS) {
+		rate = (lines - prev_lines) / ((t - prev_t) / 1e9);
+		prev_lines = lines;
+		prev_t = t;
+	}
+
+	n = snprintf(buf, len,
+	    "lines %llu\n"
+	    "lines/s %.0f\n"
+	    "malformed %llu\n"
+	    "dropped %llu\n"
+	    "values %llu\n"
+	    "coalesced %llu\n"
+	    "refreshes %llu\n"
+	    "frames %llu\n"
+	    "frame_us %.1f\n"
+	    "frame_us_max %.1f\n"
+	    "queued %llu\n",
+	    (unsigned long long) lines, rate,
+	    (unsigned long long) LOAD(malformed),
+	    (unsigned long long) LOAD(dropped),
+	    (unsigned long long) LOAD(values),
+	    (unsigned long long) LOAD(coalesced),
+	    (unsigned long long) LOAD(refreshes),
+	    (unsigned long long) LOAD(frames),
+	    LOAD(frame_ns) / 1e3, LOAD(frame_ns_max) / 1e3,
+	    (unsigned long long) LOAD(queued));
+
+	return (n < 0) ? 0 : n;
+}
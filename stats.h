@@ -0,0 +1,46 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * stats: counters of what xrtgraph has done since it started.
+ */
+struct stats
+{
+	uint64_t lines;		/* Input lines and records read */
+	uint64_t malformed;	/* Lines ignored */
+	uint64_t dropped;	/* Records lost in a full shared memory ring */
+	uint64_t values;	/* Values added to the graph */
+	uint64_t coalesced;	/* Rows drawn in a column with others */
+	uint64_t refreshes;	/* Full redraws */
+	uint64_t frames;
+	uint64_t frame_ns;	/* Drawing time of the latest frame */
+	uint64_t frame_ns_max;
+	uint64_t queued;	/* Values waiting for drawing with -thread */
+};
+
+extern struct stats stats;
+
+/*
+ * Most counters have a single writer, so an update is a relaxed load
+ * and store, plain moves without a locked instruction, and other
+ * threads still read whole values. 'lines' is also counted by the
+ * shared memory reader in the drawing thread while the -thread ingest
+ * thread counts input lines, so it is added to with STATS_ADD_SHARED,
+ * a locked add.
+ */
+#define STATS_ADD(_field, _n) \
+	__atomic_store_n(&stats._field, \
+	    __atomic_load_n(&stats._field, __ATOMIC_RELAXED) + (_n), \
+	    __ATOMIC_RELAXED)
+#define STATS_ADD_SHARED(_field, _n) \
+	__atomic_fetch_add(&stats._field, (_n), __ATOMIC_RELAXED)
+#define STATS_SET(_field, _v) \
+	__atomic_store_n(&stats._field, (_v), __ATOMIC_RELAXED)
+
+void stats_init(void);
+size_t stats_format(char *, size_t);
+
+#endif
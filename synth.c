@@ -0,0 +1,95 @@
+/*
+ * Synthetic workloads: value rows, and how many of them arrive in each
+ * frame, the same on every run and platform.
+ */
+
+#include "synth.h"
+#include "util.h"
+
+#include <string.h>
+#include <math.h>
+
+#define STEADY_ROWS	1000	/* Per frame */
+#define BURST_ROWS	20000
+#define BURST_EVERY	20	/* Frames */
+
+static const char *names[] = {
+	"steady", "bursty", "ramp", "multi"
+};
+
+/*
+ * synth_kind: workload by name, or -1 if there is no such workload.
+ */
+int
+synth_kind(const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < ARRLEN(names); i++)
+		if (strcmp(name, names[i]) == 0)
+			return i;
+
+	return -1;
+}
+
+const char*
+synth_name(int kind)
+{
+	return names[kind];
+}
+
+void
+synth_init(struct synth *synth, int kind)
+{
+	synth->kind = kind;
+	synth->nseries = (kind == SYNTH_MULTI) ? SYNTH_MAX_SERIES : 1;
+	synth->row = 0;
+	synth->seed = 1;
+}
+
+/*
+ * synth_frame_rows: number of rows arriving during the given frame.
+ */
+size_t
+synth_frame_rows(struct synth *synth, uint64_t frame)
+{
+	switch (synth->kind) {
+	case SYNTH_BURSTY:
+		return (frame % BURST_EVERY == 0) ? BURST_ROWS : 0;
+	case SYNTH_MULTI:
+		return STEADY_ROWS / SYNTH_MAX_SERIES;
+	default:
+		return STEADY_ROWS;
+	}
+}
+
+static double
+noise(struct synth *synth)
+{
+	synth->seed = (synth->seed * 1103515245 + 12345) & 0x7fffffff;
+	return synth->seed / (double) 0x7fffffff;
+}
+
+/*
+ * synth_row: next row of values, returns the number of values.
+ */
+size_t
+synth_row(struct synth *synth, double *row)
+{
+	double x;
+	size_t i;
+
+	x = synth->row++;
+	switch (synth->kind) {
+	case SYNTH_RAMP:
+		row[0] = x;
+		break;
+	default:
+		for (i = 0; i < synth->nseries; i++)
+			row[i] = 50.0 + 40.0 * sin(x / (100.0 + i * 10.0)) +
+			    5.0 * noise(synth);
+		break;
+	}
+
+	return synth->nseries;
+}
@@ -0,0 +1,31 @@
+#ifndef SYNTH_H
+#define SYNTH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Synthetic workloads for benchmarks.
+ */
+#define SYNTH_STEADY	0	/* Same number of values every frame */
+#define SYNTH_BURSTY	1	/* Idle, then many values at once */
+#define SYNTH_RAMP	2	/* Always increasing */
+#define SYNTH_MULTI	3	/* 16 series */
+
+#define SYNTH_MAX_SERIES	16
+
+struct synth
+{
+	int kind;
+	size_t nseries;
+	uint64_t row;		/* Rows generated */
+	unsigned long seed;
+};
+
+int synth_kind(const char *);
+const char* synth_name(int);
+void synth_init(struct synth *, int);
+size_t synth_frame_rows(struct synth *, uint64_t);
+size_t synth_row(struct synth *, double *);
+
+#endif
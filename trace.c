@@ -0,0 +1,117 @@
+/*
+ * Spans of time recorded into a ring allocated up front, written out
+ * as Chrome trace-event JSON for chrome://tracing or Perfetto. Only
+ * the latest spans are kept when the ring is full.
+ */
+
+#include "trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <err.h>
+
+struct span
+{
+	const char *name;	/* Static string */
+	int64_t start;
+	int64_t end;
+	int tid;
+};
+
+bool tracing;
+
+static const char *path;
+static struct span *ring;
+static size_t cap;
+static uint64_t nspan;
+static int64_t t_open;
+static pthread_t main_thread;
+
+/*
+ * trace_open: start tracing into a ring of n spans, to be written to
+ * file.
+ */
+void
+trace_open(const char *file, size_t n)
+{
+	path = file;
+	cap = n;
+
+	/*
+	 * Touch every page now rather than while tracing.
+	 */
+	if ((ring = malloc(n * sizeof(struct span))) == NULL)
+		err(1, "allocate trace");
+	memset(ring, 0, n * sizeof(struct span));
+
+	main_thread = pthread_self();
+	t_open = trace_now();
+	tracing = true;
+}
+
+int64_t
+trace_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*
+ * trace_span: record span from start until now. Spans of the drawing
+ * thread and the ingest thread may be recorded at the same time.
+ */
+void
+trace_span(const char *name, int64_t start)
+{
+	struct span *s;
+	uint64_t i;
+
+	i = __atomic_fetch_add(&nspan, 1, __ATOMIC_RELAXED);
+	s = &ring[i % cap];
+	s->name = name;
+	s->start = start;
+	s->end = trace_now();
+	s->tid = pthread_equal(pthread_self(), main_thread) ? 1 : 2;
+}
+
+/*
+ * trace_write: write spans recorded so far, oldest first, with times
+ * in microseconds from trace_open().
+ */
+void
+trace_write(void)
+{
+	uint64_t i, first, n;
+	struct span *s;
+	FILE *fp;
+
+	if (!tracing)
+		return;
+
+	n = __atomic_load_n(&nspan, __ATOMIC_RELAXED);
+	first = (n > cap) ? n - cap : 0;
+
+	if ((fp = fopen(path, "w")) == NULL) {
+		warn("%s", path);
+		return;
+	}
+	fprintf(fp, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+	fprintf(fp, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+	    "\"tid\":1,\"args\":{\"name\":\"draw\"}},\n");
+	fprintf(fp, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+	    "\"tid\":2,\"args\":{\"name\":\"ingest\"}}");
+	for (i = first; i < n; i++) {
+		s = &ring[i % cap];
+		fprintf(fp, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,"
+		    "\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", s->name, s->tid,
+		    (s->start - t_open) / 1e3, (s->end - s->start) / 1e3);
+	}
+	fprintf(fp, "\n]}\n");
+	if (fclose(fp) == EOF)
+		warn("%s", path);
+}
@@ -0,0 +1,26 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+extern bool tracing;
+
+/*
+ * A span is timed with TRACE_BEGIN() at its start and recorded with
+ * TRACE_END() at its end, both doing nothing unless tracing.
+ */
+#define TRACE_BEGIN()		(tracing ? trace_now() : 0)
+#define TRACE_END(_name, _t0) \
+	do { \
+		if (tracing) \
+			trace_span((_name), (_t0)); \
+	} while (0)
+
+void trace_open(const char *, size_t);
+int64_t trace_now(void);
+void trace_span(const char *, int64_t);
+void trace_write(void);
+
+#endif
@@ -9,10 +9,14 @@
 #include <libgen.h>
 #include <err.h>
 #include <errno.h>
+#include <time.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
 
 #include <X11/Xlib.h>
 #include <X11/Xresource.h>
 #include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
 
 #ifndef X11_APP_DEFAULTS_PATH
 #define X11_APP_DEFAULTS_PATH "/usr/X11R6/share/X11/app-defaults"
@@ -20,17 +24,372 @@
 
 #include "x11.h"
 
+static void damage(struct gfxwin *, int, int, unsigned int, unsigned int);
+static void create_pixmap(struct gfxwin *);
+static void create_image(struct gfxwin *);
+static bool attach_shm(struct gfxwin *);
+static int shm_error_handler(Display *, XErrorEvent *);
+static void destroy_image(struct gfxwin *);
+static void put_image(struct gfxwin *, int, int, int, int);
+static bool raster_usable(Display *);
+static void add_pixel(struct gfxwin *, unsigned long);
+static struct gfxwin *find_win(struct gfxctx *, Window);
+static void resize(struct gfxwin *);
+static struct gfxwin *to_parent(struct gfxwin *, int *, int *);
+static const struct gfxseg *to_parent_segments(struct gfxwin *,
+    const struct gfxseg *, size_t *);
+static int64_t now_ns(void);
+
+static bool shm_error;
+
 void
 gfxwin_clear(struct gfxwin *win,
     int x, int y, unsigned int width, unsigned int height)
 {
-	XClearArea(win->ctx->dpy, win->win, x, y, width, height, False);
+	win = to_parent(win, &x, &y);
+	if (win->img != NULL)
+		raster_fill(&win->ras, x, y, width, height, win->bgpixel);
+	else
+		XFillRectangle(win->ctx->dpy, win->pix, win->bg, x, y, width,
+		    height);
+	damage(win, x, y, width, height);
 }
 
+/*
+ * gfxctx_flush: copy damaged areas from pixmaps to windows and flush.
+ */
 void
 gfxctx_flush(struct gfxctx *ctx)
 {
-	XFlush(ctx->dpy);
+	struct gfxwin *win;
+	size_t i;
+	bool sync;
+
+	sync = false;
+	for (win = ctx->wins; win != NULL; win = win->next) {
+		if (!win->damaged)
+			continue;
+		if (win->img != NULL) {
+			put_image(win, win->dx1, win->dy1,
+			    win->dx2 - win->dx1, win->dy2 - win->dy1);
+			sync |= win->shm;
+			for (i = 0; i < win->ntext; i++)
+				XDrawImageString(ctx->dpy, win->win, win->fg,
+				    win->text[i].x, win->text[i].y +
+				    ctx->fs->ascent, win->text[i].s,
+				    strlen(win->text[i].s));
+			win->ntext = 0;
+		} else
+			XCopyArea(ctx->dpy, win->pix, win->win, win->fg,
+			    win->dx1, win->dy1, win->dx2 - win->dx1,
+			    win->dy2 - win->dy1, win->dx1, win->dy1);
+		win->damaged = false;
+	}
+
+	/*
+	 * The server reads shared memory images after the request
+	 * arrives, so wait for it before drawing over them.
+	 */
+	if (sync)
+		XSync(ctx->dpy, False);
+	else
+		XFlush(ctx->dpy);
+}
+
+static void
+damage(struct gfxwin *win, int x, int y, unsigned int width,
+    unsigned int height)
+{
+	if (!win->damaged) {
+		win->dx1 = x;
+		win->dy1 = y;
+		win->dx2 = x + width;
+		win->dy2 = y + height;
+		win->damaged = true;
+		return;
+	}
+	win->dx1 = MIN(win->dx1, x);
+	win->dy1 = MIN(win->dy1, y);
+	win->dx2 = MAX(win->dx2, (int) (x + width));
+	win->dy2 = MAX(win->dy2, (int) (y + height));
+}
+
+static void
+create_pixmap(struct gfxwin *win)
+{
+	Display *dpy;
+
+	dpy = win->ctx->dpy;
+	win->pix = XCreatePixmap(dpy, win->win, win->width, win->height,
+	    DefaultDepth(dpy, DefaultScreen(dpy)));
+	XFillRectangle(dpy, win->pix, win->bg, 0, 0, win->width,
+	    win->height);
+	win->damaged = false;
+}
+
+/*
+ * create_image: framebuffer for raster.c, in memory shared with the
+ * server if possible.
+ */
+static void
+create_image(struct gfxwin *win)
+{
+	Display *dpy;
+	Visual *visual;
+	unsigned int depth;
+	char *data;
+
+	dpy = win->ctx->dpy;
+	visual = DefaultVisual(dpy, DefaultScreen(dpy));
+	depth = DefaultDepth(dpy, DefaultScreen(dpy));
+
+	win->img = NULL;
+	win->shm = false;
+	if (win->ctx->shm) {
+		win->img = XShmCreateImage(dpy, visual, depth, ZPixmap, NULL,
+		    &win->shminfo, win->width, win->height);
+		if (win->img != NULL && attach_shm(win))
+			win->shm = true;
+		else {
+			if (win->img != NULL)
+				XDestroyImage(win->img);
+			win->img = NULL;
+			win->ctx->shm = false;
+			warnx("MIT-SHM failed, using XPutImage");
+		}
+	}
+	if (win->img == NULL) {
+		if ((data = malloc((size_t) win->width * win->height * 4)) ==
+		    NULL)
+			err(1, "allocate image");
+		win->img = XCreateImage(dpy, visual, depth, ZPixmap, 0, data,
+		    win->width, win->height, 32, 0);
+		if (win->img == NULL)
+			errx(1, "XCreateImage failed");
+	}
+
+	win->ras.pix = (uint32_t *) win->img->data;
+	win->ras.width = win->width;
+	win->ras.height = win->height;
+	win->ras.stride = win->img->bytes_per_line / 4;
+	raster_fill(&win->ras, 0, 0, win->width, win->height, win->bgpixel);
+	win->damaged = false;
+}
+
+/*
+ * attach_shm: allocate shared memory for the image and let the server
+ * attach to it, which fails e.g. on a remote display. This is the one
+ * round trip per image.
+ */
+static bool
+attach_shm(struct gfxwin *win)
+{
+	int (*handler)(Display *, XErrorEvent *);
+	Display *dpy;
+
+	dpy = win->ctx->dpy;
+	win->shminfo.shmid = shmget(IPC_PRIVATE,
+	    (size_t) win->img->bytes_per_line * win->img->height,
+	    IPC_CREAT | 0600);
+	if (win->shminfo.shmid == -1)
+		return false;
+	win->shminfo.shmaddr = shmat(win->shminfo.shmid, NULL, 0);
+	shmctl(win->shminfo.shmid, IPC_RMID, NULL);
+	if (win->shminfo.shmaddr == (void *) -1)
+		return false;
+	win->img->data = win->shminfo.shmaddr;
+	win->shminfo.readOnly = False;
+
+	shm_error = false;
+	handler = XSetErrorHandler(shm_error_handler);
+	XShmAttach(dpy, &win->shminfo);
+	XSync(dpy, False);
+	XSetErrorHandler(handler);
+	if (shm_error) {
+		shmdt(win->shminfo.shmaddr);
+		win->img->data = NULL;
+		return false;
+	}
+
+	return true;
+}
+
+static int
+shm_error_handler(Display *dpy, XErrorEvent *e)
+{
+	shm_error = true;
+	return 0;
+}
+
+static void
+destroy_image(struct gfxwin *win)
+{
+	if (win->shm) {
+		XShmDetach(win->ctx->dpy, &win->shminfo);
+		shmdt(win->shminfo.shmaddr);
+		win->img->data = NULL;
+	}
+	XDestroyImage(win->img);
+	win->img = NULL;
+}
+
+/*
+ * put_image: put area of the framebuffer to the window.
+ */
+static void
+put_image(struct gfxwin *win, int x, int y, int width, int height)
+{
+	int x2, y2;
+
+	x2 = MIN(x + width, win->ras.width);
+	y2 = MIN(y + height, win->ras.height);
+	x = MAX(x, 0);
+	y = MAX(y, 0);
+	if (x >= x2 || y >= y2)
+		return;
+
+	if (win->shm)
+		XShmPutImage(win->ctx->dpy, win->win, win->fg, win->img, x, y,
+		    x, y, x2 - x, y2 - y, False);
+	else
+		XPutImage(win->ctx->dpy, win->win, win->fg, win->img, x, y,
+		    x, y, x2 - x, y2 - y);
+}
+
+/*
+ * raster_usable: raster.c writes 32-bit pixel values in host byte
+ * order, so the server must take those.
+ */
+static bool
+raster_usable(Display *dpy)
+{
+	static const uint16_t one = 1;
+	XPixmapFormatValues *fmt;
+	int i, n, depth, order;
+	bool ok;
+
+	order = (*(const unsigned char *) &one == 1) ? LSBFirst : MSBFirst;
+	if (ImageByteOrder(dpy) != order)
+		return false;
+
+	depth = DefaultDepth(dpy, DefaultScreen(dpy));
+	if ((fmt = XListPixmapFormats(dpy, &n)) == NULL)
+		return false;
+	ok = false;
+	for (i = 0; i < n; i++)
+		if (fmt[i].depth == depth && fmt[i].bits_per_pixel == 32)
+			ok = true;
+	XFree(fmt);
+
+	return ok;
+}
+
+static void
+add_pixel(struct gfxwin *win, unsigned long pixel)
+{
+	unsigned long *p;
+
+	if ((p = realloc(win->pixel, (win->npixel + 1) * sizeof(*p))) == NULL)
+		err(1, "realloc");
+	win->pixel = p;
+	win->pixel[win->npixel++] = pixel;
+}
+
+static struct gfxwin *
+find_win(struct gfxctx *ctx, Window x11_win)
+{
+	struct gfxwin *win;
+
+	for (win = ctx->wins; win != NULL; win = win->next)
+		if (win->win == x11_win)
+			return win;
+
+	return NULL;
+}
+
+/*
+ * to_parent: window a panel draws to, with x and y moved there.
+ */
+static struct gfxwin *
+to_parent(struct gfxwin *win, int *x, int *y)
+{
+	if (win->parent == NULL)
+		return win;
+
+	*x += win->px;
+	*y += win->py;
+	return win->parent;
+}
+
+/*
+ * to_parent_segments: segments of a panel moved to its parent, cut to
+ * the panel, which is exact for the vertical and horizontal segments
+ * that are drawn. Segments outside the panel are dropped from n.
+ */
+static const struct gfxseg *
+to_parent_segments(struct gfxwin *win, const struct gfxseg *seg, size_t *n)
+{
+	struct gfxseg *t;
+	size_t i, m;
+	int w, h;
+
+	if (win->parent == NULL)
+		return seg;
+
+	if (*n > win->ntseg) {
+		if ((t = realloc(win->tseg, *n * sizeof(*t))) == NULL)
+			err(1, "realloc");
+		win->tseg = t;
+		win->ntseg = *n;
+	}
+	w = win->width - 1;
+	h = win->height - 1;
+	for (i = m = 0; i < *n; i++) {
+		if (MAX(seg[i].x1, seg[i].x2) < 0 ||
+		    MIN(seg[i].x1, seg[i].x2) > w ||
+		    MAX(seg[i].y1, seg[i].y2) < 0 ||
+		    MIN(seg[i].y1, seg[i].y2) > h)
+			continue;
+		t = &win->tseg[m++];
+		t->x1 = MAX(MIN(seg[i].x1, w), 0) + win->px;
+		t->y1 = MAX(MIN(seg[i].y1, h), 0) + win->py;
+		t->x2 = MAX(MIN(seg[i].x2, w), 0) + win->px;
+		t->y2 = MAX(MIN(seg[i].y2, h), 0) + win->py;
+	}
+	*n = m;
+	return win->tseg;
+}
+
+struct gfxwin*
+gfxwin_create_panel(struct gfxwin *parent, int x, int y, unsigned int width,
+    unsigned int height, void *data)
+{
+	struct gfxwin *win;
+
+	if (parent->parent != NULL)
+		errx(1, "panels are not nested");
+
+	if ((win = calloc(1, sizeof(struct gfxwin))) == NULL)
+		err(1, "calloc");
+	win->ctx = parent->ctx;
+	win->data = data;
+	win->parent = parent;
+	gfxwin_move_panel(win, x, y, width, height);
+
+	win->next_panel = parent->panels;
+	parent->panels = win;
+
+	return win;
+}
+
+void
+gfxwin_move_panel(struct gfxwin *win, int x, int y, unsigned int width,
+    unsigned int height)
+{
+	win->px = x;
+	win->py = y;
+	win->width = width;
+	win->height = height;
 }
 
 void*
@@ -39,6 +398,12 @@ gfxwin_data(struct gfxwin *win)
 	return win->data;
 }
 
+void
+gfxwin_set_data(struct gfxwin *win, void *data)
+{
+	win->data = data;
+}
+
 unsigned int
 gfxwin_height(struct gfxwin *win)
 {
@@ -51,6 +416,32 @@ gfxwin_textwidth(struct gfxwin *win, char *buf)
 	return XTextWidth(win->ctx->fs, buf, strlen(buf));
 }
 
+int
+gfxwin_textheight(struct gfxwin *win)
+{
+	return win->ctx->fs->ascent + win->ctx->fs->descent;
+}
+
+void
+gfxwin_draw_text(struct gfxwin *win, int x, int y, const char *s)
+{
+	struct wintext *t;
+
+	win = to_parent(win, &x, &y);
+	if (win->img != NULL) {
+		if (win->ntext == MAX_WINTEXT)
+			return;
+		t = &win->text[win->ntext++];
+		t->x = x;
+		t->y = y;
+		snprintf(t->s, sizeof(t->s), "%s", s);
+	} else
+		XDrawImageString(win->ctx->dpy, win->pix, win->fg, x,
+		    y + win->ctx->fs->ascent, s, strlen(s));
+	damage(win, x, y, XTextWidth(win->ctx->fs, s, strlen(s)),
+	    gfxwin_textheight(win));
+}
+
 unsigned int
 gfxwin_width(struct gfxwin *win)
 {
@@ -63,6 +454,12 @@ gfxwin_set_draw_callback(struct gfxwin *win, void (*draw)(struct gfxwin *))
 	win->draw = draw;
 }
 
+void
+gfxwin_set_key_callback(struct gfxwin *win, void (*key)(struct gfxwin *, int))
+{
+	win->key = key;
+}
+
 static size_t _mkresname(char *, size_t, const char *, const char *, bool);
 static size_t mkresname(char *, size_t, const char *, const char *);
 static size_t mkclassname(char *, size_t, const char *, const char *);
@@ -70,42 +467,212 @@ static size_t mkclassname(char *, size_t, const char *, const char *);
 static XrmDatabase merge_resource_databases(Display *, XrmDatabase);
 static const char *get_resource(struct gfxctx *, const char *);
 
+/*
+ * gfxwin_process_events: handle every event read so far, including
+ * those Xlib queued while waiting for a reply, which the descriptor no
+ * longer shows. Exposures only add to the damage and a window is
+ * resized once to its latest size, then everything is flushed at once.
+ */
 void
 gfxwin_process_events(struct gfxctx *ctx)
 {
 	XEvent e;
+	struct gfxwin *win, *panel;
+	char buf[8];
+	bool exposed;
+
+	exposed = false;
+	while (XPending(ctx->dpy) > 0) {
+		XNextEvent(ctx->dpy, &e);
+		if ((win = find_win(ctx, e.xany.window)) == NULL)
+			continue;
+
+		switch (e.type) {
+		case Expose:
+			/*
+			 * Restore exposed area from the pixmap, no redraw
+			 * needed.
+			 */
+			damage(win, e.xexpose.x, e.xexpose.y,
+			    e.xexpose.width, e.xexpose.height);
+			exposed |= (e.xexpose.count == 0);
+			break;
+		case ConfigureNotify:
+			win->cfg_width = e.xconfigure.width;
+			win->cfg_height = e.xconfigure.height;
+			break;
+		case KeyPress:
+			if (XLookupString(&e.xkey, buf, sizeof(buf), NULL,
+			    NULL) != 1)
+				break;
+			if (win->key != NULL)
+				win->key(win, buf[0]);
+			for (panel = win->panels; panel != NULL;
+			    panel = panel->next_panel)
+				if (panel->key != NULL)
+					panel->key(panel, buf[0]);
+			break;
+		}
+	}
 
-	XNextEvent(ctx->dpy, &e);
-#if 1
-	switch (e.type) {
-	case MapNotify:
-#if 0
-		XClearWindow(ctx->dpy, win->win);
-		win->draw(win);
-#endif
-		break;
-	case Expose:
-#if 0
-		XClearWindow(ctx->dpy, win->win);
-		win->draw(win);
-#endif
-		break;
-	case ConfigureNotify:
-#if 0
-		win->width = e.xconfigure.width;
-		win->height = e.xconfigure.height;
-		XClearWindow(ctx->dpy, win->win);
-		win->draw(win);
-#endif
-		break;
+	for (win = ctx->wins; win != NULL; win = win->next)
+		if (win->cfg_width != win->width ||
+		    win->cfg_height != win->height)
+			resize(win);
+	gfxctx_flush(ctx);
+
+	/*
+	 * Once the server has done this, the first frame is on screen.
+	 */
+	if (ctx->first_frame == 0 && exposed) {
+		XSync(ctx->dpy, False);
+		ctx->first_frame = now_ns() - ctx->t_open;
 	}
-#endif
+}
+
+/*
+ * gfxctx_pending: whether events are queued, to be handled without
+ * waiting for the descriptor.
+ */
+bool
+gfxctx_pending(struct gfxctx *ctx)
+{
+	return XEventsQueued(ctx->dpy, QueuedAlready) > 0;
+}
+
+/*
+ * resize: to the size of the latest ConfigureNotify, rebuilding the
+ * pixmap once from stored data.
+ */
+static void
+resize(struct gfxwin *win)
+{
+	struct gfxwin *panel;
+
+	win->width = win->cfg_width;
+	win->height = win->cfg_height;
+	if (win->img != NULL) {
+		destroy_image(win);
+		create_image(win);
+	} else {
+		XFreePixmap(win->ctx->dpy, win->pix);
+		create_pixmap(win);
+	}
+	if (win->draw != NULL)
+		win->draw(win);
+	for (panel = win->panels; panel != NULL; panel = panel->next_panel)
+		if (panel->draw != NULL)
+			panel->draw(panel);
+	damage(win, 0, 0, win->width, win->height);
 }
 
 void
 gfxwin_draw_line(struct gfxwin *win, int x1, int y1, int x2, int y2)
 {
-	XDrawLine(win->ctx->dpy, win->win, win->fg, x1, y1, x2, y2);
+	struct gfxseg seg;
+
+	if (win->parent != NULL) {
+		x2 += win->px;
+		y2 += win->py;
+	}
+	win = to_parent(win, &x1, &y1);
+	if (win->img != NULL) {
+		seg.x1 = x1;
+		seg.y1 = y1;
+		seg.x2 = x2;
+		seg.y2 = y2;
+		raster_segments(&win->ras, win->pixel[GFXWIN_FG], &seg, 1);
+	} else
+		XDrawLine(win->ctx->dpy, win->pix, win->fg, x1, y1, x2, y2);
+	damage(win, MIN(x1, x2), MIN(y1, y2), abs(x2 - x1) + 1,
+	    abs(y2 - y1) + 1);
+}
+
+void
+gfxwin_draw_segments(struct gfxwin *win, int color, const struct gfxseg *seg,
+    size_t n)
+{
+	size_t i;
+	GC gc;
+
+	seg = to_parent_segments(win, seg, &n);
+	if (win->parent != NULL)
+		win = win->parent;
+	if (win->img != NULL)
+		raster_segments(&win->ras, win->pixel[color], seg, n);
+	else {
+		if (color == GFXWIN_FG)
+			gc = win->fg;
+		else if (color == GFXWIN_HL)
+			gc = win->hl;
+		else
+			gc = win->gc[color - GFXWIN_HL - 1];
+		XDrawSegments(win->ctx->dpy, win->pix, gc, (XSegment *) seg,
+		    n);
+	}
+	for (i = 0; i < n; i++)
+		damage(win, MIN(seg[i].x1, seg[i].x2),
+		    MIN(seg[i].y1, seg[i].y2), abs(seg[i].x2 - seg[i].x1) + 1,
+		    abs(seg[i].y2 - seg[i].y1) + 1);
+}
+
+int
+gfxwin_alloc_color(struct gfxwin *win, const char *spec)
+{
+	XGCValues v;
+	XColor exact, color;
+	Colormap colormap;
+	char **gcspec;
+	size_t i;
+	GC *gc;
+
+	/*
+	 * Panels share the colors of the window.
+	 */
+	if (win->parent != NULL)
+		win = win->parent;
+	for (i = 0; i < win->ngc; i++)
+		if (strcmp(win->gcspec[i], spec) == 0)
+			return GFXWIN_HL + 1 + i;
+
+	colormap = DefaultColormap(win->ctx->dpy,
+	    DefaultScreen(win->ctx->dpy));
+	if (XAllocNamedColor(win->ctx->dpy, colormap, spec, &color, &exact) ==
+	    False)
+		errx(1, "couldn't parse color '%s'", spec);
+
+	if ((gc = realloc(win->gc, (win->ngc + 1) * sizeof(GC))) == NULL ||
+	    (gcspec = realloc(win->gcspec, (win->ngc + 1) *
+	    sizeof(char *))) == NULL)
+		err(1, "realloc");
+	win->gc = gc;
+	win->gcspec = gcspec;
+	if ((win->gcspec[win->ngc] = strdup(spec)) == NULL)
+		err(1, "strdup");
+
+	v.foreground = color.pixel;
+	win->gc[win->ngc++] = XCreateGC(win->ctx->dpy, win->win, GCForeground,
+	    &v);
+	add_pixel(win, color.pixel);
+
+	return GFXWIN_HL + win->ngc;
+}
+
+void
+gfxwin_copy_area(struct gfxwin *win, int sx, int sy, unsigned int width,
+    unsigned int height, int dx, int dy)
+{
+	if (win->parent != NULL) {
+		sx += win->px;
+		sy += win->py;
+	}
+	win = to_parent(win, &dx, &dy);
+	if (win->img != NULL)
+		raster_copy(&win->ras, sx, sy, width, height, dx, dy);
+	else
+		XCopyArea(win->ctx->dpy, win->pix, win->pix, win->fg, sx, sy,
+		    width, height, dx, dy);
+	damage(win, dx, dy, width, height);
 }
 
 struct gfxwin*
@@ -134,6 +701,7 @@ gfxwin_create(struct gfxctx *ctx, int _x, int _y, unsigned int _width,
 		errx(1, "couldn't parse window background color");
 	a.background_pixel = color.pixel;
 	mask = CWBackPixel;
+	v.foreground = color.pixel;
 
 	/*
 	 * Geometry.
@@ -156,7 +724,8 @@ gfxwin_create(struct gfxctx *ctx, int _x, int _y, unsigned int _width,
 	root = RootWindow(ctx->dpy, DefaultScreen(ctx->dpy));
 	x11_win = XCreateWindow(ctx->dpy, root, _x, _y, _width, _height, 0,
 	    CopyFromParent, InputOutput, CopyFromParent, mask, &a);
-	XSelectInput(ctx->dpy, x11_win, ExposureMask | StructureNotifyMask);
+	XSelectInput(ctx->dpy, x11_win, ExposureMask | StructureNotifyMask |
+	    KeyPressMask);
 
 	/*
 	 * Window structure.
@@ -166,14 +735,32 @@ gfxwin_create(struct gfxctx *ctx, int _x, int _y, unsigned int _width,
 	win->win = x11_win;
 	win->x = _x;
 	win->y = _y;
-	win->width = _width;
-	win->height = _height;
+	win->width = win->cfg_width = _width;
+	win->height = win->cfg_height = _height;
 	win->ctx = ctx;
 	win->data = data;
+	win->draw = NULL;
+	win->key = NULL;
+	win->gc = NULL;
+	win->gcspec = NULL;
+	win->ngc = 0;
+	win->pixel = NULL;
+	win->npixel = 0;
+	win->img = NULL;
+	win->ntext = 0;
+	win->parent = NULL;
+	win->px = win->py = 0;
+	win->panels = NULL;
+	win->next_panel = NULL;
+	win->tseg = NULL;
+	win->ntseg = 0;
 
 	/*
 	 * GC.
 	 */
+	win->bg = XCreateGC(ctx->dpy, win->win, GCForeground, &v);
+	win->bgpixel = v.foreground;
+
 	fgspec = NULL;
 	if ((fgspec = get_resource(ctx, "foreground")) == NULL)
 		fgspec = "black";	
@@ -182,8 +769,11 @@ gfxwin_create(struct gfxctx *ctx, int _x, int _y, unsigned int _width,
 		errx(1, "couldn't parse window foreground color");
 	v.foreground = color.pixel;
 	v.font = ctx->fs->fid;
-	mask = GCForeground | GCFont;
+	v.background = win->bgpixel;	/* Under text */
+	v.graphics_exposures = False;	/* No NoExpose per XCopyArea */
+	mask = GCForeground | GCBackground | GCFont | GCGraphicsExposures;
 	win->fg = XCreateGC(ctx->dpy, win->win, mask, &v);
+	add_pixel(win, color.pixel);
 
 	hlspec = NULL;
 	if ((hlspec = get_resource(ctx, "highlight")) == NULL)
@@ -195,6 +785,7 @@ gfxwin_create(struct gfxctx *ctx, int _x, int _y, unsigned int _width,
 	v.font = ctx->fs->fid;
 	mask = GCForeground | GCFont;
 	win->hl = XCreateGC(ctx->dpy, win->win, mask, &v);
+	add_pixel(win, color.pixel);
 
 	/*
 	 * Set WM properties.
@@ -202,6 +793,13 @@ gfxwin_create(struct gfxctx *ctx, int _x, int _y, unsigned int _width,
 	XStoreName(ctx->dpy, win->win, ctx->name);
 	XSetCommand(ctx->dpy, win->win, ctx->argv, ctx->argc);
 
+	if (ctx->raster)
+		create_image(win);
+	else
+		create_pixmap(win);
+	win->next = ctx->wins;
+	ctx->wins = win;
+
 	XMapWindow(ctx->dpy, win->win);
 
 	XSync(ctx->dpy, False);
@@ -215,6 +813,23 @@ gfxctx_fd(struct gfxctx *ctx)
 	return ConnectionNumber(ctx->dpy);
 }
 
+int64_t
+gfxctx_first_frame(struct gfxctx *ctx)
+{
+	return ctx->first_frame;
+}
+
+static int64_t
+now_ns(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) == -1)
+		err(1, "clock_gettime");
+
+	return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
 struct gfxctx *
 gfxctx_open(int *argc, char **argv)
 {
@@ -234,11 +849,16 @@ gfxctx_open(int *argc, char **argv)
 		{ "-bg", "*background", XrmoptionSepArg, NULL },
 		{ "-hl", "*highlight", XrmoptionSepArg, NULL },
 		{ "-font", "*font", XrmoptionSepArg, NULL },
-		{ "-geometry", "*geometry", XrmoptionSepArg, NULL }
+		{ "-geometry", "*geometry", XrmoptionSepArg, NULL },
+		{ "-raster", "*raster", XrmoptionNoArg, "on" }
 	};
+	const char *raster;
 
 	if ((ctx = malloc(sizeof(struct gfxctx))) == NULL)
 		err(1, "malloc");
+	ctx->wins = NULL;
+	ctx->t_open = now_ns();
+	ctx->first_frame = 0;
 
 	XrmInitialize();
 	XrmParseCommand(&cmdline, optable, ARRLEN(optable), argv[0],
@@ -283,6 +903,20 @@ gfxctx_open(int *argc, char **argv)
 	if (ctx->fs == NULL)
 		errx(1, "couldn't find substitute font");
 
+	/*
+	 * Software rendering, presented with MIT-SHM if available.
+	 */
+	ctx->raster = false;
+	ctx->shm = false;
+	if ((raster = get_resource(ctx, "raster")) != NULL &&
+	    (strcmp(raster, "on") == 0 || strcmp(raster, "true") == 0)) {
+		ctx->raster = raster_usable(ctx->dpy);
+		if (!ctx->raster)
+			warnx("no 32-bit pixels in host byte order, not "
+			    "using raster");
+		ctx->shm = (XShmQueryExtension(ctx->dpy) == True);
+	}
+
 	return ctx;
 }
 
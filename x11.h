@@ -3,6 +3,12 @@
 
 #include <X11/Xlib.h>
 #include <X11/Xresource.h>
+#include <X11/extensions/XShm.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "raster.h"
 
 struct gfxctx
 {
@@ -16,6 +22,24 @@ struct gfxctx
 	char argc;
 	char **argv;
 	XFontStruct *fs;
+	struct gfxwin *wins;
+	bool raster;		/* Draw with raster.c */
+	bool shm;		/* MIT-SHM works */
+	int64_t t_open;		/* When gfxctx_open() was called */
+	int64_t first_frame;
+};
+
+/*
+ * wintext: text to draw over the raster on flush, as raster.c has no
+ * font.
+ */
+#define MAX_WINTEXT 16
+
+struct wintext
+{
+	int x;
+	int y;
+	char s[64];
 };
 
 struct gfxwin
@@ -24,11 +48,52 @@ struct gfxwin
 	int y;
 	int width;
 	int height;
+	int cfg_width;		/* Size in the latest ConfigureNotify */
+	int cfg_height;
 	Window win;
-	GC fg, hl;
+	GC fg, hl, bg;
+	GC *gc;			/* Colors from gfxwin_alloc_color() */
+	char **gcspec;
+	size_t ngc;
 	void (*draw)(struct gfxwin *win);
+	void (*key)(struct gfxwin *win, int key);
 	struct gfxctx *ctx;
 	void *data;
+	struct gfxwin *next;
+
+	/*
+	 * Everything is drawn to the pixmap; damaged area is copied to
+	 * the window on flush and exposed areas are copied on Expose.
+	 */
+	Pixmap pix;
+	bool damaged;
+	int dx1, dy1, dx2, dy2;
+
+	/*
+	 * With the raster resource, everything is drawn to 'ras' in
+	 * client memory instead and put to the window on flush, with
+	 * MIT-SHM if possible.
+	 */
+	struct raster ras;
+	XImage *img;
+	XShmSegmentInfo shminfo;
+	bool shm;
+	unsigned long bgpixel;
+	unsigned long *pixel;	/* Of colors, GFXWIN_FG first */
+	size_t npixel;
+	struct wintext text[MAX_WINTEXT];
+	size_t ntext;
+
+	/*
+	 * A panel draws to its parent at px, py. Segments are moved
+	 * there in 'tseg'.
+	 */
+	struct gfxwin *parent;
+	int px, py;
+	struct gfxwin *panels;
+	struct gfxwin *next_panel;
+	struct gfxseg *tseg;
+	size_t ntseg;
 };
 
 #endif
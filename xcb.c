@@ -0,0 +1,910 @@
+/*
+ * gfxctx.h on XCB. Requests are sent up front and their replies are
+ * collected together, so that startup costs the connection setup and
+ * a single wait for the colors. The font is loaded only when text is
+ * first measured and the keyboard mapping when a key is first pressed.
+ * Only the command line is read for options, not X resources.
+ */
+
+#include "util.h"
+#include "gfxctx.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <libgen.h>
+#include <time.h>
+#include <err.h>
+
+#include "xcb.h"
+
+#define NCOLOR		3	/* Background, foreground, highlight */
+
+static void damage(struct gfxwin *, int, int, unsigned int, unsigned int);
+static void create_pixmap(struct gfxwin *);
+static struct gfxwin *find_win(struct gfxctx *, xcb_window_t);
+static struct gfxwin *to_parent(struct gfxwin *, int *, int *);
+static const struct gfxseg *to_parent_segments(struct gfxwin *,
+    const struct gfxseg *, size_t *);
+static bool handle_event(struct gfxctx *, xcb_generic_event_t *);
+static void resize(struct gfxwin *);
+static int keychar(struct gfxctx *, xcb_keycode_t, uint16_t);
+static uint32_t color_pixel(struct gfxctx *, xcb_alloc_named_color_cookie_t,
+    const char *);
+static void load_font(struct gfxctx *);
+static void char_widths(struct gfxctx *, xcb_query_font_reply_t *);
+static int char_width(xcb_query_font_reply_t *, unsigned int);
+static void parse_geometry(const char *, int *, int *, unsigned int *,
+    unsigned int *);
+static void sync_conn(struct gfxctx *);
+static int64_t now_ns(void);
+
+void
+gfxwin_clear(struct gfxwin *win,
+    int x, int y, unsigned int width, unsigned int height)
+{
+	xcb_rectangle_t r;
+
+	win = to_parent(win, &x, &y);
+	r.x = x;
+	r.y = y;
+	r.width = width;
+	r.height = height;
+	xcb_poly_fill_rectangle(win->ctx->conn, win->pix, win->bg, 1, &r);
+	damage(win, x, y, width, height);
+}
+
+/*
+ * gfxctx_flush: copy damaged areas from pixmaps to windows and flush.
+ */
+void
+gfxctx_flush(struct gfxctx *ctx)
+{
+	struct gfxwin *win;
+
+	for (win = ctx->wins; win != NULL; win = win->next) {
+		if (!win->damaged)
+			continue;
+		xcb_copy_area(ctx->conn, win->pix, win->win, win->fg,
+		    win->dx1, win->dy1, win->dx1, win->dy1,
+		    win->dx2 - win->dx1, win->dy2 - win->dy1);
+		win->damaged = false;
+	}
+	xcb_flush(ctx->conn);
+}
+
+static void
+damage(struct gfxwin *win, int x, int y, unsigned int width,
+    unsigned int height)
+{
+	if (!win->damaged) {
+		win->dx1 = x;
+		win->dy1 = y;
+		win->dx2 = x + width;
+		win->dy2 = y + height;
+		win->damaged = true;
+		return;
+	}
+	win->dx1 = MIN(win->dx1, x);
+	win->dy1 = MIN(win->dy1, y);
+	win->dx2 = MAX(win->dx2, (int) (x + width));
+	win->dy2 = MAX(win->dy2, (int) (y + height));
+}
+
+static void
+create_pixmap(struct gfxwin *win)
+{
+	struct gfxctx *ctx = win->ctx;
+	xcb_rectangle_t r;
+
+	win->pix = xcb_generate_id(ctx->conn);
+	xcb_create_pixmap(ctx->conn, ctx->screen->root_depth, win->pix,
+	    win->win, win->width, win->height);
+	r.x = r.y = 0;
+	r.width = win->width;
+	r.height = win->height;
+	xcb_poly_fill_rectangle(ctx->conn, win->pix, win->bg, 1, &r);
+	win->damaged = false;
+}
+
+static struct gfxwin *
+find_win(struct gfxctx *ctx, xcb_window_t xcb_win)
+{
+	struct gfxwin *win;
+
+	for (win = ctx->wins; win != NULL; win = win->next)
+		if (win->win == xcb_win)
+			return win;
+
+	return NULL;
+}
+
+/*
+ * to_parent: window a panel draws to, with x and y moved there.
+ */
+static struct gfxwin *
+to_parent(struct gfxwin *win, int *x, int *y)
+{
+	if (win->parent == NULL)
+		return win;
+
+	*x += win->px;
+	*y += win->py;
+	return win->parent;
+}
+
+/*
+ * to_parent_segments: segments of a panel moved to its parent, cut to
+ * the panel, which is exact for the vertical and horizontal segments
+ * that are drawn. Segments outside the panel are dropped from n.
+ */
+static const struct gfxseg *
+to_parent_segments(struct gfxwin *win, const struct gfxseg *seg, size_t *n)
+{
+	struct gfxseg *t;
+	size_t i, m;
+	int w, h;
+
+	if (win->parent == NULL)
+		return seg;
+
+	if (*n > win->ntseg) {
+		if ((t = realloc(win->tseg, *n * sizeof(*t))) == NULL)
+			err(1, "realloc");
+		win->tseg = t;
+		win->ntseg = *n;
+	}
+	w = win->width - 1;
+	h = win->height - 1;
+	for (i = m = 0; i < *n; i++) {
+		if (MAX(seg[i].x1, seg[i].x2) < 0 ||
+		    MIN(seg[i].x1, seg[i].x2) > w ||
+		    MAX(seg[i].y1, seg[i].y2) < 0 ||
+		    MIN(seg[i].y1, seg[i].y2) > h)
+			continue;
+		t = &win->tseg[m++];
+		t->x1 = MAX(MIN(seg[i].x1, w), 0) + win->px;
+		t->y1 = MAX(MIN(seg[i].y1, h), 0) + win->py;
+		t->x2 = MAX(MIN(seg[i].x2, w), 0) + win->px;
+		t->y2 = MAX(MIN(seg[i].y2, h), 0) + win->py;
+	}
+	*n = m;
+	return win->tseg;
+}
+
+struct gfxwin*
+gfxwin_create_panel(struct gfxwin *parent, int x, int y, unsigned int width,
+    unsigned int height, void *data)
+{
+	struct gfxwin *win;
+
+	if (parent->parent != NULL)
+		errx(1, "panels are not nested");
+
+	if ((win = calloc(1, sizeof(struct gfxwin))) == NULL)
+		err(1, "calloc");
+	win->ctx = parent->ctx;
+	win->data = data;
+	win->parent = parent;
+	gfxwin_move_panel(win, x, y, width, height);
+
+	win->next_panel = parent->panels;
+	parent->panels = win;
+
+	return win;
+}
+
+void
+gfxwin_move_panel(struct gfxwin *win, int x, int y, unsigned int width,
+    unsigned int height)
+{
+	win->px = x;
+	win->py = y;
+	win->width = width;
+	win->height = height;
+}
+
+void*
+gfxwin_data(struct gfxwin *win)
+{
+	return win->data;
+}
+
+void
+gfxwin_set_data(struct gfxwin *win, void *data)
+{
+	win->data = data;
+}
+
+unsigned int
+gfxwin_height(struct gfxwin *win)
+{
+	return win->height;
+}
+
+int
+gfxwin_textwidth(struct gfxwin *win, char *buf)
+{
+	const unsigned char *s;
+	int width;
+
+	load_font(win->ctx);
+
+	width = 0;
+	for (s = (const unsigned char *) buf; *s != '\0'; s++)
+		width += win->ctx->charwidth[*s];
+
+	return width;
+}
+
+/*
+ * load_font: open the font the first time it is needed, falling back
+ * to "fixed" like the Xlib backend. Widths of the characters are kept
+ * so that text is measured without a round trip.
+ */
+static void
+load_font(struct gfxctx *ctx)
+{
+	xcb_query_font_reply_t *r;
+	xcb_generic_error_t *e;
+	const char *spec;
+	int tries;
+
+	if (ctx->font != 0)
+		return;
+
+	spec = (ctx->fontspec != NULL) ? ctx->fontspec : "fixed";
+	for (tries = 2; tries > 0; tries--) {
+		ctx->font = xcb_generate_id(ctx->conn);
+		e = xcb_request_check(ctx->conn, xcb_open_font_checked(
+		    ctx->conn, ctx->font, strlen(spec), spec));
+		if (e == NULL) {
+			r = xcb_query_font_reply(ctx->conn,
+			    xcb_query_font(ctx->conn, ctx->font), NULL);
+			if (r == NULL)
+				errx(1, "couldn't query font");
+			ctx->ascent = r->font_ascent;
+			ctx->descent = r->font_descent;
+			char_widths(ctx, r);
+			free(r);
+			return;
+		}
+		free(e);
+
+		warnx("couldn't load font");
+		spec = "fixed";
+	}
+	errx(1, "couldn't find substitute font");
+}
+
+/*
+ * char_widths: width of each of the characters text is drawn with,
+ * which are the first row of a matrix font. Characters the font does
+ * not have are drawn as its default character.
+ */
+static void
+char_widths(struct gfxctx *ctx, xcb_query_font_reply_t *r)
+{
+	unsigned int c;
+	int w;
+
+	for (c = 0; c < 256; c++) {
+		if ((w = char_width(r, c)) < 0)
+			w = MAX(char_width(r, r->default_char), 0);
+		ctx->charwidth[c] = w;
+	}
+}
+
+/*
+ * char_width: width of character c, or -1 if the font has none.
+ */
+static int
+char_width(xcb_query_font_reply_t *r, unsigned int c)
+{
+	xcb_charinfo_t *ci;
+	unsigned int byte1, byte2, cols;
+
+	byte1 = c >> 8;
+	byte2 = c & 0xff;
+	if (byte1 < r->min_byte1 || byte1 > r->max_byte1 ||
+	    byte2 < r->min_char_or_byte2 || byte2 > r->max_char_or_byte2)
+		return -1;
+	if (xcb_query_font_char_infos_length(r) == 0)
+		return r->max_bounds.character_width;
+
+	cols = r->max_char_or_byte2 - r->min_char_or_byte2 + 1;
+	ci = xcb_query_font_char_infos(r) + (byte1 - r->min_byte1) * cols +
+	    (byte2 - r->min_char_or_byte2);
+	if (ci->character_width == 0 && ci->left_side_bearing == 0 &&
+	    ci->right_side_bearing == 0 && ci->ascent == 0 &&
+	    ci->descent == 0)
+		return -1;
+	return ci->character_width;
+}
+
+int
+gfxwin_textheight(struct gfxwin *win)
+{
+	load_font(win->ctx);
+
+	return win->ctx->ascent + win->ctx->descent;
+}
+
+void
+gfxwin_draw_text(struct gfxwin *win, int x, int y, const char *s)
+{
+	struct gfxctx *ctx = win->ctx;
+	uint32_t font;
+	size_t len;
+
+	load_font(ctx);
+	win = to_parent(win, &x, &y);
+	if (!win->fontset) {
+		font = ctx->font;
+		xcb_change_gc(ctx->conn, win->fg, XCB_GC_FONT, &font);
+		win->fontset = true;
+	}
+
+	len = MIN(strlen(s), 255);
+	xcb_image_text_8(ctx->conn, len, win->pix, win->fg, x,
+	    y + ctx->ascent, s);
+	damage(win, x, y, gfxwin_textwidth(win, (char *) s),
+	    ctx->ascent + ctx->descent);
+}
+
+unsigned int
+gfxwin_width(struct gfxwin *win)
+{
+	return win->width;
+}
+
+void
+gfxwin_set_draw_callback(struct gfxwin *win, void (*draw)(struct gfxwin *))
+{
+	win->draw = draw;
+}
+
+void
+gfxwin_set_key_callback(struct gfxwin *win, void (*key)(struct gfxwin *, int))
+{
+	win->key = key;
+}
+
+/*
+ * gfxwin_process_events: handle every event that has arrived,
+ * including those XCB queued while waiting for a reply, which the
+ * descriptor no longer shows. Exposures only add to the damage and a
+ * window is resized once to its latest size, then everything is
+ * flushed at once.
+ */
+void
+gfxwin_process_events(struct gfxctx *ctx)
+{
+	xcb_generic_event_t *e;
+	struct gfxwin *win;
+	bool exposed;
+
+	exposed = false;
+	if ((e = ctx->queued) != NULL) {
+		ctx->queued = NULL;
+		exposed |= handle_event(ctx, e);
+		free(e);
+	}
+	while ((e = xcb_poll_for_event(ctx->conn)) != NULL) {
+		exposed |= handle_event(ctx, e);
+		free(e);
+	}
+	if (xcb_connection_has_error(ctx->conn))
+		errx(1, "X11 connection lost");
+
+	for (win = ctx->wins; win != NULL; win = win->next)
+		if (win->cfg_width != win->width ||
+		    win->cfg_height != win->height)
+			resize(win);
+	gfxctx_flush(ctx);
+
+	/*
+	 * Once the server has done this, the first frame is on screen.
+	 */
+	if (ctx->first_frame == 0 && exposed) {
+		sync_conn(ctx);
+		ctx->first_frame = now_ns() - ctx->t_open;
+	}
+}
+
+/*
+ * gfxctx_pending: whether events are queued, to be handled without
+ * waiting for the descriptor. XCB cannot peek, so the event is kept
+ * for gfxwin_process_events().
+ */
+bool
+gfxctx_pending(struct gfxctx *ctx)
+{
+	if (ctx->queued == NULL)
+		ctx->queued = xcb_poll_for_queued_event(ctx->conn);
+	return ctx->queued != NULL;
+}
+
+/*
+ * handle_event: returns true on the last of a series of exposures.
+ */
+static bool
+handle_event(struct gfxctx *ctx, xcb_generic_event_t *e)
+{
+	xcb_expose_event_t *expose;
+	xcb_configure_notify_event_t *configure;
+	xcb_key_press_event_t *key;
+	struct gfxwin *win, *panel;
+	int c;
+
+	switch (e->response_type & ~0x80) {
+	case 0:
+		warnx("X11 error %d",
+		    ((xcb_generic_error_t *) e)->error_code);
+		break;
+	case XCB_EXPOSE:
+		expose = (xcb_expose_event_t *) e;
+		if ((win = find_win(ctx, expose->window)) == NULL)
+			break;
+
+		/*
+		 * Restore exposed area from the pixmap, no redraw needed.
+		 */
+		damage(win, expose->x, expose->y, expose->width,
+		    expose->height);
+		return expose->count == 0;
+	case XCB_CONFIGURE_NOTIFY:
+		configure = (xcb_configure_notify_event_t *) e;
+		if ((win = find_win(ctx, configure->window)) == NULL)
+			break;
+		win->cfg_width = configure->width;
+		win->cfg_height = configure->height;
+		break;
+	case XCB_KEY_PRESS:
+		key = (xcb_key_press_event_t *) e;
+		if ((win = find_win(ctx, key->event)) == NULL)
+			break;
+		if ((c = keychar(ctx, key->detail, key->state)) == -1)
+			break;
+		if (win->key != NULL)
+			win->key(win, c);
+		for (panel = win->panels; panel != NULL;
+		    panel = panel->next_panel)
+			if (panel->key != NULL)
+				panel->key(panel, c);
+		break;
+	}
+
+	return false;
+}
+
+/*
+ * resize: to the size of the latest ConfigureNotify, rebuilding the
+ * pixmap once from stored data.
+ */
+static void
+resize(struct gfxwin *win)
+{
+	struct gfxwin *panel;
+
+	win->width = win->cfg_width;
+	win->height = win->cfg_height;
+	xcb_free_pixmap(win->ctx->conn, win->pix);
+	create_pixmap(win);
+	if (win->draw != NULL)
+		win->draw(win);
+	for (panel = win->panels; panel != NULL; panel = panel->next_panel)
+		if (panel->draw != NULL)
+			panel->draw(panel);
+	damage(win, 0, 0, win->width, win->height);
+}
+
+/*
+ * keychar: character of a key, or -1 if it is not printable ASCII,
+ * whose keysyms are the same as the characters.
+ */
+static int
+keychar(struct gfxctx *ctx, xcb_keycode_t code, uint16_t state)
+{
+	const xcb_setup_t *setup;
+	xcb_keysym_t *syms, sym;
+	int per, col;
+
+	if (ctx->kbd == NULL) {
+		ctx->kbd = xcb_get_keyboard_mapping_reply(ctx->conn,
+		    ctx->kbdcookie, NULL);
+		if (ctx->kbd == NULL)
+			errx(1, "couldn't get keyboard mapping");
+	}
+
+	setup = xcb_get_setup(ctx->conn);
+	if (code < setup->min_keycode || code > setup->max_keycode)
+		return -1;
+
+	syms = xcb_get_keyboard_mapping_keysyms(ctx->kbd);
+	per = ctx->kbd->keysyms_per_keycode;
+	col = ((state & XCB_MOD_MASK_SHIFT) && per > 1) ? 1 : 0;
+	sym = syms[(code - setup->min_keycode) * per + col];
+	if (sym == 0 && col == 1)
+		sym = syms[(code - setup->min_keycode) * per];
+
+	return (sym >= 0x20 && sym <= 0x7e) ? (int) sym : -1;
+}
+
+void
+gfxwin_draw_line(struct gfxwin *win, int x1, int y1, int x2, int y2)
+{
+	xcb_segment_t seg;
+
+	if (win->parent != NULL) {
+		x2 += win->px;
+		y2 += win->py;
+	}
+	win = to_parent(win, &x1, &y1);
+	seg.x1 = x1;
+	seg.y1 = y1;
+	seg.x2 = x2;
+	seg.y2 = y2;
+	xcb_poly_segment(win->ctx->conn, win->pix, win->fg, 1, &seg);
+	damage(win, MIN(x1, x2), MIN(y1, y2), abs(x2 - x1) + 1,
+	    abs(y2 - y1) + 1);
+}
+
+/*
+ * gfxwin_draw_segments: XCB does not split requests like Xlib does, so
+ * send at most maxseg segments at a time.
+ */
+void
+gfxwin_draw_segments(struct gfxwin *win, int color, const struct gfxseg *seg,
+    size_t n)
+{
+	xcb_gcontext_t gc;
+	size_t i, m;
+
+	seg = to_parent_segments(win, seg, &n);
+	if (win->parent != NULL)
+		win = win->parent;
+	if (color == GFXWIN_FG)
+		gc = win->fg;
+	else if (color == GFXWIN_HL)
+		gc = win->hl;
+	else
+		gc = win->gc[color - GFXWIN_HL - 1];
+
+	for (i = 0; i < n; i += m) {
+		m = MIN(n - i, win->ctx->maxseg);
+		xcb_poly_segment(win->ctx->conn, win->pix, gc, m,
+		    (const xcb_segment_t *) &seg[i]);
+	}
+	for (i = 0; i < n; i++)
+		damage(win, MIN(seg[i].x1, seg[i].x2),
+		    MIN(seg[i].y1, seg[i].y2), abs(seg[i].x2 - seg[i].x1) + 1,
+		    abs(seg[i].y2 - seg[i].y1) + 1);
+}
+
+int
+gfxwin_alloc_color(struct gfxwin *win, const char *spec)
+{
+	struct gfxctx *ctx = win->ctx;
+	xcb_gcontext_t *gc;
+	uint32_t pixel;
+	char **gcspec;
+	size_t i;
+
+	/*
+	 * Panels share the colors of the window.
+	 */
+	if (win->parent != NULL)
+		win = win->parent;
+	for (i = 0; i < win->ngc; i++)
+		if (strcmp(win->gcspec[i], spec) == 0)
+			return GFXWIN_HL + 1 + i;
+
+	pixel = color_pixel(ctx, xcb_alloc_named_color(ctx->conn,
+	    ctx->screen->default_colormap, strlen(spec), spec), spec);
+
+	if ((gc = realloc(win->gc, (win->ngc + 1) * sizeof(*gc))) == NULL ||
+	    (gcspec = realloc(win->gcspec, (win->ngc + 1) *
+	    sizeof(char *))) == NULL)
+		err(1, "realloc");
+	win->gc = gc;
+	win->gcspec = gcspec;
+	if ((win->gcspec[win->ngc] = strdup(spec)) == NULL)
+		err(1, "strdup");
+
+	win->gc[win->ngc] = xcb_generate_id(ctx->conn);
+	xcb_create_gc(ctx->conn, win->gc[win->ngc], win->win,
+	    XCB_GC_FOREGROUND, &pixel);
+	win->ngc++;
+
+	return GFXWIN_HL + win->ngc;
+}
+
+void
+gfxwin_copy_area(struct gfxwin *win, int sx, int sy, unsigned int width,
+    unsigned int height, int dx, int dy)
+{
+	if (win->parent != NULL) {
+		sx += win->px;
+		sy += win->py;
+	}
+	win = to_parent(win, &dx, &dy);
+	xcb_copy_area(win->ctx->conn, win->pix, win->pix, win->fg, sx, sy,
+	    dx, dy, width, height);
+	damage(win, dx, dy, width, height);
+}
+
+/*
+ * color_pixel: wait for reply to color allocation.
+ */
+static uint32_t
+color_pixel(struct gfxctx *ctx, xcb_alloc_named_color_cookie_t cookie,
+    const char *spec)
+{
+	xcb_alloc_named_color_reply_t *r;
+	xcb_generic_error_t *e;
+	uint32_t pixel;
+
+	if ((r = xcb_alloc_named_color_reply(ctx->conn, cookie, &e)) == NULL) {
+		free(e);
+		errx(1, "couldn't parse color '%s'", spec);
+	}
+	pixel = r->pixel;
+	free(r);
+
+	return pixel;
+}
+
+struct gfxwin*
+gfxwin_create(struct gfxctx *ctx, int _x, int _y, unsigned int _width,
+    unsigned int _height, const char *_bgspec, void *data)
+{
+	xcb_alloc_named_color_cookie_t cookie[NCOLOR];
+	const char *spec[NCOLOR];
+	struct gfxwin *win;
+	uint32_t values[2], pixel[NCOLOR];
+	size_t i, len;
+	char *cmd;
+	int j;
+
+	/*
+	 * Ask for the colors first and collect the replies only after
+	 * everything else has been sent.
+	 */
+	spec[0] = (ctx->bgspec != NULL) ? ctx->bgspec : _bgspec;
+	spec[1] = (ctx->fgspec != NULL) ? ctx->fgspec : "black";
+	spec[2] = (ctx->hlspec != NULL) ? ctx->hlspec : "red";
+	for (i = 0; i < NCOLOR; i++)
+		cookie[i] = xcb_alloc_named_color(ctx->conn,
+		    ctx->screen->default_colormap, strlen(spec[i]), spec[i]);
+
+	if (ctx->geometry != NULL)
+		parse_geometry(ctx->geometry, &_x, &_y, &_width, &_height);
+
+	/*
+	 * Window structure.
+	 */
+	if ((win = calloc(1, sizeof(struct gfxwin))) == NULL)
+		err(1, "calloc");
+	win->x = _x;
+	win->y = _y;
+	win->width = win->cfg_width = _width;
+	win->height = win->cfg_height = _height;
+	win->ctx = ctx;
+	win->data = data;
+
+	/*
+	 * Create window, background is set once the color is known.
+	 */
+	win->win = xcb_generate_id(ctx->conn);
+	values[0] = XCB_EVENT_MASK_EXPOSURE | XCB_EVENT_MASK_STRUCTURE_NOTIFY |
+	    XCB_EVENT_MASK_KEY_PRESS;
+	xcb_create_window(ctx->conn, XCB_COPY_FROM_PARENT, win->win,
+	    ctx->screen->root, _x, _y, _width, _height, 0,
+	    XCB_WINDOW_CLASS_INPUT_OUTPUT, ctx->screen->root_visual,
+	    XCB_CW_EVENT_MASK, values);
+
+	/*
+	 * GC.
+	 */
+	values[0] = 0;		/* No NoExpose per copy */
+	win->bg = xcb_generate_id(ctx->conn);
+	xcb_create_gc(ctx->conn, win->bg, win->win, 0, NULL);
+	win->fg = xcb_generate_id(ctx->conn);
+	xcb_create_gc(ctx->conn, win->fg, win->win,
+	    XCB_GC_GRAPHICS_EXPOSURES, values);
+	win->hl = xcb_generate_id(ctx->conn);
+	xcb_create_gc(ctx->conn, win->hl, win->win, 0, NULL);
+
+	/*
+	 * Set WM properties.
+	 */
+	xcb_change_property(ctx->conn, XCB_PROP_MODE_REPLACE, win->win,
+	    XCB_ATOM_WM_NAME, XCB_ATOM_STRING, 8, strlen(ctx->name),
+	    ctx->name);
+	for (len = 0, j = 0; j < ctx->argc; j++)
+		len += strlen(ctx->argv[j]) + 1;
+	if ((cmd = malloc(len)) == NULL)
+		err(1, "malloc");
+	for (len = 0, j = 0; j < ctx->argc; j++) {
+		strcpy(&cmd[len], ctx->argv[j]);
+		len += strlen(ctx->argv[j]) + 1;
+	}
+	xcb_change_property(ctx->conn, XCB_PROP_MODE_REPLACE, win->win,
+	    XCB_ATOM_WM_COMMAND, XCB_ATOM_STRING, 8, len, cmd);
+	free(cmd);
+
+	/*
+	 * All replies at once.
+	 */
+	for (i = 0; i < NCOLOR; i++)
+		pixel[i] = color_pixel(ctx, cookie[i], spec[i]);
+	xcb_change_gc(ctx->conn, win->bg, XCB_GC_FOREGROUND, &pixel[0]);
+	values[0] = pixel[1];
+	values[1] = pixel[0];	/* Under text */
+	xcb_change_gc(ctx->conn, win->fg, XCB_GC_FOREGROUND |
+	    XCB_GC_BACKGROUND, values);
+	xcb_change_gc(ctx->conn, win->hl, XCB_GC_FOREGROUND, &pixel[2]);
+	xcb_change_window_attributes(ctx->conn, win->win, XCB_CW_BACK_PIXEL,
+	    &pixel[0]);
+
+	create_pixmap(win);
+	win->next = ctx->wins;
+	ctx->wins = win;
+
+	xcb_map_window(ctx->conn, win->win);
+	xcb_flush(ctx->conn);
+
+	return win;
+}
+
+/*
+ * parse_geometry: [<width>x<height>][{+-}<x>{+-}<y>], any part
+ * optional as in XParseGeometry(3).
+ */
+static void
+parse_geometry(const char *s, int *x, int *y, unsigned int *width,
+    unsigned int *height)
+{
+	char *end;
+	long v;
+
+	if (*s == '=')
+		s++;
+	if (*s >= '0' && *s <= '9') {
+		v = strtol(s, &end, 10);
+		if (*end == 'x' || *end == 'X') {
+			*width = v;
+			s = end + 1;
+			*height = strtol(s, &end, 10);
+		}
+		s = end;
+	}
+	if (*s == '+' || *s == '-') {
+		*x = strtol(s, &end, 10);
+		s = end;
+		if (*s == '+' || *s == '-')
+			*y = strtol(s, &end, 10);
+	}
+}
+
+int
+gfxctx_fd(struct gfxctx *ctx)
+{
+	return xcb_get_file_descriptor(ctx->conn);
+}
+
+int64_t
+gfxctx_first_frame(struct gfxctx *ctx)
+{
+	return ctx->first_frame;
+}
+
+/*
+ * sync_conn: round trip, for when the server must have handled what
+ * has been sent.
+ */
+static void
+sync_conn(struct gfxctx *ctx)
+{
+	free(xcb_get_input_focus_reply(ctx->conn,
+	    xcb_get_input_focus(ctx->conn), NULL));
+}
+
+static int64_t
+now_ns(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) == -1)
+		err(1, "clock_gettime");
+
+	return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+struct gfxctx *
+gfxctx_open(int *argc, char **argv)
+{
+	static const char *optable[] = {
+		"-display", "-fg", "-bg", "-hl", "-font", "-geometry"
+	};
+	const char **optval[ARRLEN(optable)];
+	const char *dname;
+	const xcb_setup_t *setup;
+	struct gfxctx *ctx;
+	int i, j, screen;
+	size_t k;
+
+	if ((ctx = calloc(1, sizeof(struct gfxctx))) == NULL)
+		err(1, "calloc");
+	ctx->t_open = now_ns();
+
+	/*
+	 * Standard X11 options.
+	 */
+	dname = NULL;
+	optval[0] = &dname;
+	optval[1] = &ctx->fgspec;
+	optval[2] = &ctx->bgspec;
+	optval[3] = &ctx->hlspec;
+	optval[4] = &ctx->fontspec;
+	optval[5] = &ctx->geometry;
+	for (i = j = 1; i < *argc; i++) {
+		for (k = 0; k < ARRLEN(optable); k++)
+			if (strcmp(argv[i], optable[k]) == 0)
+				break;
+		if (k < ARRLEN(optable) && i + 1 < *argc) {
+			*optval[k] = argv[i + 1];
+			i++;
+		} else if (strcmp(argv[i], "-raster") == 0)
+			warnx("-raster is not supported with XCB, ignored");
+		else
+			argv[j++] = argv[i];
+	}
+	argv[j] = NULL;
+	*argc = j;
+
+	if (*argc != 1)
+		return NULL;
+
+	ctx->argc = *argc;
+	ctx->argv = argv;
+
+	if ((ctx->name = basename(argv[0])) == NULL)
+		err(1, "basename");
+
+	ctx->conn = xcb_connect(dname, &screen);
+	if (xcb_connection_has_error(ctx->conn)) {
+		/*
+		 * The name xcb_connect() used, like XDisplayName().
+		 */
+		if (dname == NULL && (dname = getenv("DISPLAY")) == NULL)
+			dname = "";
+		errx(1, "failed X11 connection to '%s'", dname);
+	}
+
+	setup = xcb_get_setup(ctx->conn);
+	{
+		xcb_screen_iterator_t it;
+
+		it = xcb_setup_roots_iterator(setup);
+		for (; screen > 0 && it.rem > 0; screen--)
+			xcb_screen_next(&it);
+		ctx->screen = it.data;
+	}
+
+	/*
+	 * Request length is in units of four bytes, a PolySegment
+	 * request has a header of 12 bytes and 8 bytes per segment.
+	 */
+	ctx->maxseg = (setup->maximum_request_length * 4 - 12) / 8;
+
+	/*
+	 * Only asked for now, the reply is read on the first key press.
+	 */
+	ctx->kbdcookie = xcb_get_keyboard_mapping(ctx->conn,
+	    setup->min_keycode, setup->max_keycode - setup->min_keycode + 1);
+
+	return ctx;
+}
@@ -0,0 +1,82 @@
+#ifndef XCB_H
+#define XCB_H
+
+#include <xcb/xcb.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct gfxctx
+{
+	xcb_connection_t *conn;
+	xcb_screen_t *screen;
+	char *name;
+
+	/*
+	 * For restarting commands using WM Command property.
+	 */
+	int argc;
+	char **argv;
+
+	/*
+	 * From the command line, X resources are not read.
+	 */
+	const char *fgspec;
+	const char *bgspec;
+	const char *hlspec;
+	const char *fontspec;
+	const char *geometry;
+
+	xcb_font_t font;	/* Loaded when first needed */
+	int ascent, descent;
+	int charwidth[256];	/* Of each byte of text */
+	xcb_get_keyboard_mapping_cookie_t kbdcookie;
+	xcb_get_keyboard_mapping_reply_t *kbd;
+	size_t maxseg;		/* Segments per request */
+	struct gfxwin *wins;
+	xcb_generic_event_t *queued;	/* Taken by gfxctx_pending() */
+	int64_t t_open;		/* When gfxctx_open() was called */
+	int64_t first_frame;
+};
+
+struct gfxwin
+{
+	int x;
+	int y;
+	int width;
+	int height;
+	int cfg_width;		/* Size in the latest ConfigureNotify */
+	int cfg_height;
+	xcb_window_t win;
+	xcb_gcontext_t fg, hl, bg;
+	xcb_gcontext_t *gc;	/* Colors from gfxwin_alloc_color() */
+	char **gcspec;
+	size_t ngc;
+	bool fontset;		/* fg has the font */
+	void (*draw)(struct gfxwin *win);
+	void (*key)(struct gfxwin *win, int key);
+	struct gfxctx *ctx;
+	void *data;
+	struct gfxwin *next;
+
+	/*
+	 * Everything is drawn to the pixmap; damaged area is copied to
+	 * the window on flush and exposed areas are copied on Expose.
+	 */
+	xcb_pixmap_t pix;
+	bool damaged;
+	int dx1, dy1, dx2, dy2;
+
+	/*
+	 * A panel draws to its parent at px, py. Segments are moved
+	 * there in 'tseg'.
+	 */
+	struct gfxwin *parent;
+	int px, py;
+	struct gfxwin *panels;
+	struct gfxwin *next_panel;
+	struct gfxseg *tseg;
+	size_t ntseg;
+};
+
+#endif
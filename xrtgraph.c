@@ -15,55 +15,206 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include "dashboard.h"
 #include "graph.h"
 #include "gfxctx.h"
+#include "ingest.h"
+#include "numparse.h"
+#include "poller.h"
+#include "procsrc.h"
+#include "queue.h"
+#include "stats.h"
+#include "trace.h"
+#include "xrtshm.h"
 #include "util.h"
 
 #include <string.h>
 #include <ctype.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <sys/select.h>
+#include <sys/stat.h>
+#include <fcntl.h>
 
 #include <unistd.h>
 #include <time.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 #include <err.h>
 #include <errno.h>
+#include <pthread.h>
+#include <signal.h>
 
 #include <sys/socket.h>
 #include <sys/un.h>
 
 /*
- * MAX_VALS: Maximum number of values shown at a time.
- * This should be close to maximum window width.
+ * DEFAULT_HISTORY: Number of values stored, unless changed with
+ * -history.
  */
-#define MAX_VALS 4096
+#define DEFAULT_HISTORY 4096
 
 /*
- * MAX_COMPOSITE: Maximum number of cumulative graph feeds.
+ * DEFAULT_FPS: Maximum number of frames drawn per second, unless
+ * changed with -fps. Values are read at full speed regardless.
  */
-#define MAX_COMPOSITE 8
+#define DEFAULT_FPS 60
 
-#if WANT_COMPOSITE
 /*
- * composite_color: Colors for the composite graphs. Increase
- * colors here if MAX_COMPOSITE is grown.
+ * DEFAULT_INTERVAL: Milliseconds between samples of -src sources,
+ * unless changed with -interval.
  */
-static const char *composite_color[] = {
-	"orange", "cyan", "magenta", "green",
-	"yellow", "blue", "red", "pink"
+#define DEFAULT_INTERVAL 1000
+
+/*
+ * MAX_READY: Maximum number of inputs handled per wakeup.
+ */
+#define MAX_READY 64
+
+/*
+ * INGEST_BUDGET: Bytes read per wakeup of the drawing loop before X
+ * events and drawing get their turn. Inputs left over are still ready
+ * on the next wakeup.
+ */
+#define INGEST_BUDGET (1 << 20)
+
+/*
+ * MAX_SHM_RECORDS: Maximum number of records taken from the shared
+ * memory ring per frame, so that a producer outpacing us cannot keep
+ * us from drawing.
+ */
+#define MAX_SHM_RECORDS (1 << 20)
+
+/*
+ * QUEUE_SIZE: Number of values queued from the ingest thread, enough
+ * to ride out a few seconds of the display stalling at high rates.
+ */
+#define QUEUE_SIZE (1 << 20)
+
+/*
+ * TRACE_SPANS: Number of latest spans kept with -trace, some minutes
+ * of drawing at full frame rate.
+ */
+#define TRACE_SPANS (1 << 19)
+
+/*
+ * Input formats.
+ */
+#define FORMAT_TEXT	0	/* Lines of numbers */
+#define FORMAT_F32	1	/* float */
+#define FORMAT_F64	2	/* double */
+#define FORMAT_TS64F64	3	/* struct tsrecord */
+
+/*
+ * tsrecord: binary record with a time in nanoseconds since the Epoch.
+ */
+struct tsrecord
+{
+	int64_t time;
+	double value;
 };
-#endif
 
+/*
+ * MAX_QUEUE_ENTRIES: Maximum number of values taken from the ingest
+ * thread per frame.
+ */
+#define MAX_QUEUE_ENTRIES (1 << 20)
+
+/*
+ * client: standard input or an -input file, feeding a series per
+ * column, or a producer connected to the -socket, feeding a series of
+ * its own or with -grid a panel of its own.
+ */
 struct client
 {
-	int fd;
-	int composite;
+	struct ingest *in;
+	struct graph *graph;
+	int series;		/* -1 for a series per column */
+	int panel;		/* Of a producer with -grid, otherwise -1 */
 };
 
-static void read_data(struct graph *, char *, size_t, int);
+/*
+ * derivation: series derived from a column with -derive, or replacing
+ * it with -transform.
+ */
+struct derivation
+{
+	size_t column;
+	int kind;
+	double param;
+	bool keep;
+};
+
+static int fps = DEFAULT_FPS;
+static size_t history = DEFAULT_HISTORY;
+static int reduce = GRAPH_REDUCE_MAX;
+static bool timestamps;
+static int format = FORMAT_TEXT;
+static const char *socketpath;
+static const char *shmname;
+static bool threaded;
+static bool ttff;		/* Report time to first frame */
+static const char *statspath;
+static int lfd = -1;		/* Listening -socket */
+static int sfd = -1;		/* Listening -stats socket */
+static volatile sig_atomic_t dump_stats;
+static volatile sig_atomic_t quit;
+static const char *tracepath;
+static int grid_cols, grid_rows;	/* 0 unless -grid */
+static const char *inputs[DASHBOARD_MAX_PANELS];
+static int ninputs;
+static const char *srcspecs[GRAPH_MAX_SERIES];
+static struct procsrc *srcs[GRAPH_MAX_SERIES];
+static int nsrcs;
+static int64_t interval = DEFAULT_INTERVAL * INT64_C(1000000);
+static struct derivation derivations[GRAPH_MAX_SERIES];
+static int nderivations;
+
+/*
+ * Graphs shown, one per panel with -grid.
+ */
+static struct graph *graphs[DASHBOARD_MAX_PANELS];
+static int ngraphs;
+static bool panel_used[DASHBOARD_MAX_PANELS];
+
+/*
+ * With -thread, values read are queued for the drawing thread and the
+ * ingest thread wakes it through the pipe unless already woken.
+ */
+static struct queue *queue;
+static int wakefd[2];
+static bool woken;
+static bool series_used[GRAPH_MAX_SERIES];
+
+static struct client *client_create(int, struct graph *, int, int);
+static void client_close(struct poller *, struct client *);
+static int listen_socket(const char *);
+static void write_stats(int);
+static void sigusr1(int);
+static void sigquit(int);
+static void accept_client(struct poller *, int);
+static size_t handle_input(struct poller *, void *);
+static void *ingest_thread(void *);
+static void wake(void);
+static ssize_t read_data(struct client *);
+static void add(struct graph *, int64_t, int, const double *, size_t);
+static bool drain_queue(struct graph *);
+static void read_shm(struct graph *, struct xrtshm *);
+static void read_sources(void);
+static size_t parse_row(const char *, const char *, double *);
+static void malformed(const char *);
+static void parse_args(int *, char **);
+static long numarg(const char *, const char *, long, long);
+static int reducearg(const char *, const char *);
+static int formatarg(const char *, const char *);
+static void gridarg(const char *, const char *);
+static void derivearg(const char *, const char *, bool);
+static void add_lines(struct graph *, struct client *, int64_t);
+static void add_records(struct graph *, struct client *, int64_t);
+static void swap_le(void *, size_t, size_t);
+static int64_t now_ns(void);
+static int64_t timestamp(void);
 
 static void
 exit_with_usage(const char *progname)
@@ -73,8 +224,26 @@ exit_with_usage(const char *progname)
 	    "\t[-geometry <geometrystring>]\n"\
 	    "\t[-hl <highlight color>]\n"\
 	    "\t[-bg <background color>]\n"\
+	    "\t[-derive <column>:rate|delta|avg|ewma[:<param>]]\n"\
 	    "\t[-font <fontspec>]\n"\
-	    "\t[-fg <foreground color>]\n",
+	    "\t[-fg <foreground color>]\n"\
+	    "\t[-raster]\n"\
+	    "\t[-format text|f32|f64|ts64f64]\n"\
+	    "\t[-fps <frames per second>]\n"\
+	    "\t[-grid <columns>x<rows>]\n"\
+	    "\t[-history <number of values>]\n"\
+	    "\t[-input <file>]\n"\
+	    "\t[-interval <milliseconds>]\n"\
+	    "\t[-reduce max|avg|envelope|lttb]\n"\
+	    "\t[-shm <name>]\n"\
+	    "\t[-socket <path>]\n"\
+	    "\t[-src <source>]\n"\
+	    "\t[-stats <path>]\n"\
+	    "\t[-thread]\n"\
+	    "\t[-timestamps]\n"\
+	    "\t[-trace <file>]\n"\
+	    "\t[-transform <column>:rate|delta|avg|ewma[:<param>]]\n"\
+	    "\t[-ttff]\n",
 	    progname);
 	exit(1);	
 }
@@ -82,29 +251,151 @@ exit_with_usage(const char *progname)
 int
 main(int argc, char **argv)
 {
-	int maxfd, nready;
-	fd_set readfds;
-	char buf[64];
-	int n;
+	int nready, i, j, fd;
 	struct graph *graph;
-	char *socketpath;
+	struct poller *poller, *inpoller;
+	struct xrtshm *shm;
+	pthread_t thread;
+	char buf[64];
+	void *ready[MAX_READY];
 	int gfxfd;
 	struct gfxctx *ctx;
+	struct dashboard *dash;
+	int64_t next_frame, next_sample, frame_ns, wait, t, t0;
+	struct sigaction sa;
+	sigset_t sigs;
+	size_t budget;
+	bool pending, events;
 
 #ifdef __OpenBSD__
-	if (pledge("stdio rpath prot_exec dns unix inet", NULL) != 0)
+	if (pledge("stdio rpath cpath prot_exec dns unix inet", NULL) != 0)
 		err(1, "pledge");
 #endif
 
+	parse_args(&argc, argv);
 	if ((ctx = gfxctx_open(&argc, argv)) == NULL)
 		exit_with_usage(argv[0]);
 
-	graph = graph_create(ctx);
+	/*
+	 * With -grid, a graph per panel of one window, sharing its
+	 * colors, font and pixmap.
+	 */
+	if (grid_cols > 0) {
+		dash = dashboard_create(ctx, grid_cols, grid_rows);
+		for (i = 0; i < dashboard_npanels(dash); i++)
+			graphs[ngraphs++] = graph_create_in(
+			    dashboard_panel(dash, i), history);
+	} else
+		graphs[ngraphs++] = graph_create(ctx, history);
+	if (grid_cols > 0 && ninputs + nsrcs > ngraphs)
+		errx(1, "%d inputs and sources for %d panels",
+		    ninputs + nsrcs, ngraphs);
+	for (i = 0; i < ngraphs; i++) {
+		if (reduce != GRAPH_REDUCE_MAX)
+			graph_reduce(graphs[i], reduce);
+		for (j = 0; j < nderivations; j++)
+			graph_derive(graphs[i], derivations[j].column,
+			    derivations[j].kind, derivations[j].param,
+			    derivations[j].keep);
+	}
+	graph = graphs[0];
 
-	socketpath = NULL;
+	gfxfd = gfxctx_fd(ctx);
+	poller = poller_create();
+	poller_add(poller, gfxfd, ctx);
 
-#ifdef __OpenBSD__
+	/*
+	 * With -thread, inputs are read by a thread of their own, so
+	 * that the display being slow does not stall the producers.
+	 */
+	inpoller = poller;
+	if (threaded) {
+		inpoller = poller_create();
+		queue = queue_create(QUEUE_SIZE);
+		if (pipe(wakefd) == -1)
+			err(1, "pipe");
+		poller_add(poller, wakefd[0], wakefd);
+	}
+
+	/*
+	 * Read standard input or -input files, or producers connecting
+	 * to the socket or writing to shared memory.
+	 */
 	if (socketpath != NULL) {
+		lfd = listen_socket(socketpath);
+		poller_add(inpoller, lfd, &lfd);
+	}
+	shm = NULL;
+	if (shmname != NULL) {
+		if (fps == 0)
+			errx(1, "-shm is read once per frame, -fps must not "
+			    "be 0");
+		if ((shm = xrtshm_attach(shmname)) == NULL)
+			err(1, "%s", shmname);
+	}
+	for (i = 0; i < ninputs; i++) {
+		if ((fd = open(inputs[i], O_RDONLY)) == -1)
+			err(1, "%s", inputs[i]);
+		poller_add(inpoller, fd, client_create(fd, graphs[i], -1, -1));
+	}
+	for (i = 0; i < nsrcs; i++) {
+		srcs[i] = procsrc_open(srcspecs[i]);
+		if (grid_cols == 0)
+			series_used[i] = true;
+	}
+	if (socketpath == NULL && shm == NULL && ninputs == 0 && nsrcs == 0)
+		poller_add(inpoller, STDIN_FILENO,
+		    client_create(STDIN_FILENO, graph, -1, -1));
+
+	/*
+	 * Stats are dumped to standard error on SIGUSR1 and to whoever
+	 * connects to the -stats socket, by the drawing thread.
+	 */
+	if (statspath != NULL) {
+		sfd = listen_socket(statspath);
+		poller_add(poller, sfd, &sfd);
+		signal(SIGPIPE, SIG_IGN);
+	}
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = sigusr1;
+	sigemptyset(&sa.sa_mask);
+	if (sigaction(SIGUSR1, &sa, NULL) == -1)
+		err(1, "sigaction");
+
+	/*
+	 * The trace is written on exit, also when asked to quit.
+	 */
+	if (tracepath != NULL) {
+		trace_open(tracepath, TRACE_SPANS);
+		if (atexit(trace_write) != 0)
+			err(1, "atexit");
+		sa.sa_handler = sigquit;
+		if (sigaction(SIGINT, &sa, NULL) == -1 ||
+		    sigaction(SIGTERM, &sa, NULL) == -1 ||
+		    sigaction(SIGHUP, &sa, NULL) == -1)
+			err(1, "sigaction");
+	}
+
+	/*
+	 * Base for the timestamps, before the ingest thread uses it.
+	 */
+	timestamp();
+	stats_init();
+	if (threaded) {
+		sigemptyset(&sigs);
+		sigaddset(&sigs, SIGUSR1);
+		sigaddset(&sigs, SIGINT);
+		sigaddset(&sigs, SIGTERM);
+		sigaddset(&sigs, SIGHUP);
+		pthread_sigmask(SIG_BLOCK, &sigs, NULL);
+		if ((errno = pthread_create(&thread, NULL, ingest_thread,
+		    inpoller)) != 0)
+			err(1, "pthread_create");
+		pthread_sigmask(SIG_UNBLOCK, &sigs, NULL);
+	}
+
+#ifdef __OpenBSD__
+	if (socketpath != NULL || statspath != NULL) {
 		if (pledge("stdio unix", NULL) != 0)
 			err(1, "pledge");
 	} else {
@@ -113,85 +404,884 @@ main(int argc, char **argv)
 	}
 #endif
 
-	gfxfd = gfxctx_fd(ctx);
-
+	frame_ns = (fps > 0) ? 1000000000 / fps : 0;
+	next_frame = 0;
+	next_sample = now_ns();
+	pending = false;
 	for (;;) {
-		FD_ZERO(&readfds);
+		if (dump_stats) {
+			dump_stats = 0;
+			write_stats(STDERR_FILENO);
+		}
+		if (quit)
+			exit(0);
 
-		FD_SET(gfxfd, &readfds);
-		maxfd = gfxfd;
+		/*
+		 * Wake up for the next frame if there is something to
+		 * draw or shared memory to read, otherwise sleep until
+		 * there is input or the sources are due.
+		 */
+		t = now_ns();
+		wait = (pending || shm != NULL) ? MAX(next_frame - t, 0) : -1;
+		if (nsrcs > 0 && (wait < 0 || next_sample - t < wait))
+			wait = MAX(next_sample - t, 0);
+		if (gfxctx_pending(ctx))
+			wait = 0;
+		t0 = TRACE_BEGIN();
+		nready = poller_wait(poller, ready, MAX_READY, wait);
+		TRACE_END("wait", t0);
+		if (nready == -1) {
+			if (errno == EINTR)
+				continue;
+			err(1, "poller_wait");
+		}
 
-			FD_SET(STDIN_FILENO, &readfds);
-			if (STDIN_FILENO > maxfd)
-				maxfd = STDIN_FILENO;		
+		/*
+		 * Inputs are read up to the budget, but X events are
+		 * handled on every wakeup, all of them, so that the
+		 * window keeps responding at any input rate.
+		 */
+		events = gfxctx_pending(ctx);
+		budget = INGEST_BUDGET;
+		for (i = 0; i < nready; i++) {
+			if (ready[i] == ctx) {
+				events = true;
+				continue;
+			}
+			if (ready[i] == &sfd) {
+				if ((fd = accept(sfd, NULL, NULL)) == -1) {
+					warn("accept");
+					continue;
+				}
+				write_stats(fd);
+				close(fd);
+				continue;
+			}
+			if (ready[i] == wakefd) {
+				if (read(wakefd[0], buf, sizeof(buf)) == -1)
+					err(1, "read");
+				__atomic_store_n(&woken, false,
+				    __ATOMIC_RELEASE);
+			} else if (budget > 0)
+				budget -= MIN(handle_input(poller, ready[i]),
+				    budget);
+			else
+				continue;
+			pending = true;
+		}
+		if (events) {
+			t0 = TRACE_BEGIN();
+			gfxwin_process_events(ctx);
+			TRACE_END("events", t0);
+		}
 
+		/*
+		 * Sample the sources, skipping samples missed rather than
+		 * catching up.
+		 */
+		if (nsrcs > 0 && (t = now_ns()) >= next_sample) {
+			t0 = TRACE_BEGIN();
+			read_sources();
+			TRACE_END("sample", t0);
+			next_sample += interval;
+			if (next_sample <= t)
+				next_sample = t + interval;
+			pending = true;
+		}
 
-		nready = select(maxfd + 1, &readfds, NULL, NULL, NULL);
-		if (nready == -1)
-			err(1, "select");
+		/*
+		 * Draw everything read since the previous frame at once.
+		 */
+		if ((pending || shm != NULL) && now_ns() >= next_frame) {
+			pending = false;
+			t0 = TRACE_BEGIN();
+			if (queue != NULL)
+				pending = drain_queue(graph);
+			if (shm != NULL)
+				read_shm(graph, shm);
+			TRACE_END("drain", t0);
+			t = now_ns();
+			for (i = 0; i < ngraphs; i++)
+				graph_draw(graphs[i]);
+			t0 = TRACE_BEGIN();
+			gfxctx_flush(ctx);
+			TRACE_END("flush", t0);
+			next_frame = now_ns();
+			t = next_frame - t;
+			next_frame += frame_ns;
 
-#if WANT_COMPOSITE
-		if (socketpath != NULL && FD_ISSET(sfd, &readfds)) {
-			int fd;
+			STATS_ADD(frames, 1);
+			STATS_SET(frame_ns, t);
+			if (t > (int64_t) stats.frame_ns_max)
+				STATS_SET(frame_ns_max, t);
+		}
 
-			warnx("accept");
-			for (i = 0; i < MAX_COMPOSITE; i++)
-				if (graph.clients[i].fd == -1)
-					break;
-			fd = accept(sfd, NULL, NULL);
-			if (i == MAX_COMPOSITE ||
-			    graph.ncomposite == MAX_COMPOSITE) {
-				warnx("max composite reached");
-				close(fd);
-			} else {
-				graph.clients[i].fd = fd;
-				graph.clients[i].composite =
-				    graph.ncomposite++;
-				warnx("accepted as composite %d",
-				    graph.clients[i].composite);
+		if (ttff && gfxctx_first_frame(ctx) != 0) {
+			warnx("first frame in %.1f ms",
+			    gfxctx_first_frame(ctx) / 1e6);
+			ttff = false;
+		}
+	}
+}
+
+/*
+ * client_create: client feeding graph, or with -thread the queue.
+ */
+static struct client *
+client_create(int fd, struct graph *graph, int series, int panel)
+{
+	struct client *c;
+
+	if ((c = malloc(sizeof(struct client))) == NULL)
+		err(1, "allocate client");
+	c->in = ingest_create(fd);
+	c->graph = graph;
+	c->series = series;
+	c->panel = panel;
+	if (series >= 0)
+		series_used[series] = true;
+	if (panel >= 0)
+		panel_used[panel] = true;
+
+	return c;
+}
+
+/*
+ * client_close: stop reading client, giving its series or panel to
+ * the next producer connecting.
+ */
+static void
+client_close(struct poller *poller, struct client *c)
+{
+	poller_del(poller, ingest_fd(c->in));
+	close(ingest_fd(c->in));
+	if (c->series >= 0)
+		series_used[c->series] = false;
+	if (c->panel >= 0)
+		panel_used[c->panel] = false;
+	ingest_free(c->in);
+	free(c);
+}
+
+/*
+ * listen_socket: listen for producers at path, replacing a socket
+ * left behind by a previous run.
+ */
+static int
+listen_socket(const char *path)
+{
+	struct sockaddr_un sun;
+	struct stat st;
+	int fd;
+
+	memset(&sun, 0, sizeof(sun));
+	sun.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(sun.sun_path))
+		errx(1, "%s: socket path too long", path);
+	strcpy(sun.sun_path, path);
+
+	if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode) &&
+	    unlink(path) == -1)
+		err(1, "unlink %s", path);
+
+	if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1)
+		err(1, "socket");
+	if (bind(fd, (struct sockaddr *) &sun, sizeof(sun)) == -1)
+		err(1, "bind %s", path);
+	if (listen(fd, SOMAXCONN) == -1)
+		err(1, "listen");
+
+	return fd;
+}
+
+/*
+ * write_stats: write the stats as lines of name and value.
+ */
+static void
+write_stats(int fd)
+{
+	char buf[512];
+	size_t n;
+	ssize_t w;
+	char *p;
+
+	n = MIN(stats_format(buf, sizeof(buf)), sizeof(buf) - 1);
+	for (p = buf; n > 0; p += w, n -= w)
+		if ((w = write(fd, p, n)) == -1) {
+			if (errno == EINTR) {
+				w = 0;
+				continue;
 			}
+			warn("write stats");
+			return;
 		}
-		for (i = 0; i < MAX_COMPOSITE; i++) {
-			if (graph.clients[i].fd == -1)
+}
+
+static void
+sigusr1(int sig)
+{
+	dump_stats = 1;
+}
+
+static void
+sigquit(int sig)
+{
+	quit = 1;
+}
+
+/*
+ * handle_input: accept producer or read input that is ready. Returns
+ * the number of bytes read. At the end of an input the graph stays on
+ * screen.
+ */
+static size_t
+handle_input(struct poller *poller, void *ready)
+{
+	struct client *c;
+	ssize_t n;
+
+	if (ready == &lfd) {
+		accept_client(poller, lfd);
+		return 0;
+	}
+
+	c = ready;
+	if ((n = read_data(c)) <= 0) {
+		client_close(poller, c);
+		return 0;
+	}
+	return n;
+}
+
+/*
+ * ingest_thread: read inputs and queue what was read for the drawing
+ * thread.
+ */
+static void *
+ingest_thread(void *arg)
+{
+	struct poller *poller = arg;
+	void *ready[MAX_READY];
+	int nready, i;
+	int64_t t0;
+
+	for (;;) {
+		t0 = TRACE_BEGIN();
+		nready = poller_wait(poller, ready, MAX_READY, -1);
+		TRACE_END("wait", t0);
+		if (nready == -1) {
+			if (errno == EINTR)
+				continue;
+			err(1, "poller_wait");
+		}
+		for (i = 0; i < nready; i++)
+			handle_input(poller, ready[i]);
+		wake();
+	}
+
+	return NULL;
+}
+
+/*
+ * wake: tell the drawing thread there is something in the queue,
+ * once until it has looked.
+ */
+static void
+wake(void)
+{
+	if (__atomic_exchange_n(&woken, true, __ATOMIC_ACQ_REL))
+		return;
+	if (write(wakefd[1], "", 1) == -1)
+		err(1, "write");
+}
+
+/*
+ * accept_client: accept producer as the first free series, or with
+ * -grid as the first free panel after those of the -input files and
+ * -src sources.
+ */
+static void
+accept_client(struct poller *poller, int lfd)
+{
+	int fd, series, panel;
+
+	if ((fd = accept(lfd, NULL, NULL)) == -1) {
+		warn("accept");
+		return;
+	}
+
+	if (grid_cols > 0) {
+		for (panel = ninputs + nsrcs; panel < ngraphs; panel++)
+			if (!panel_used[panel])
+				break;
+		if (panel == ngraphs) {
+			warnx("no free panel, closing connection");
+			close(fd);
+			return;
+		}
+		poller_add(poller, fd, client_create(fd, graphs[panel], -1,
+		    panel));
+		return;
+	}
+
+	for (series = 0; series < GRAPH_MAX_SERIES; series++)
+		if (!series_used[series])
+			break;
+	if (series == GRAPH_MAX_SERIES) {
+		warnx("no free series, closing connection");
+		close(fd);
+		return;
+	}
+
+	poller_add(poller, fd, client_create(fd, graphs[0], series, -1));
+}
+
+static long
+numarg(const char *opt, const char *s, long min, long max)
+{
+	char *end;
+	long v;
+
+	errno = 0;
+	v = strtol(s, &end, 10);
+	if (errno != 0 || *s == '\0' || *end != '\0' || v < min || v > max)
+		errx(1, "%s: invalid value '%s'", opt, s);
+
+	return v;
+}
+
+static int
+reducearg(const char *opt, const char *s)
+{
+	static const struct {
+		const char *name;
+		int reduce;
+	} reducetab[] = {
+		{ "max", GRAPH_REDUCE_MAX },
+		{ "avg", GRAPH_REDUCE_AVG },
+		{ "envelope", GRAPH_REDUCE_ENVELOPE },
+		{ "lttb", GRAPH_REDUCE_LTTB }
+	};
+	size_t i;
+
+	for (i = 0; i < ARRLEN(reducetab); i++)
+		if (strcmp(s, reducetab[i].name) == 0)
+			return reducetab[i].reduce;
+
+	errx(1, "%s: invalid value '%s'", opt, s);
+}
+
+static int
+formatarg(const char *opt, const char *s)
+{
+	static const struct {
+		const char *name;
+		int format;
+	} formattab[] = {
+		{ "text", FORMAT_TEXT },
+		{ "f32", FORMAT_F32 },
+		{ "f64", FORMAT_F64 },
+		{ "ts64f64", FORMAT_TS64F64 }
+	};
+	size_t i;
+
+	for (i = 0; i < ARRLEN(formattab); i++)
+		if (strcmp(s, formattab[i].name) == 0)
+			return formattab[i].format;
+
+	errx(1, "%s: invalid value '%s'", opt, s);
+}
+
+static void
+gridarg(const char *opt, const char *s)
+{
+	long cols, rows;
+	char *end;
+
+	errno = 0;
+	rows = 0;
+	cols = strtol(s, &end, 10);
+	if (errno == 0 && *end == 'x')
+		rows = strtol(end + 1, &end, 10);
+	if (errno != 0 || *end != '\0' ||
+	    cols < 1 || cols > DASHBOARD_MAX_PANELS ||
+	    rows < 1 || rows > DASHBOARD_MAX_PANELS ||
+	    cols * rows > DASHBOARD_MAX_PANELS)
+		errx(1, "%s: invalid value '%s'", opt, s);
+	grid_cols = cols;
+	grid_rows = rows;
+}
+
+/*
+ * derivearg: <column>:<kind>[:<param>], param being the window of a
+ * moving average, 10 values by default, or the weight of a new value
+ * in an EWMA, 0.1 by default.
+ */
+static void
+derivearg(const char *opt, const char *s, bool keep)
+{
+	static const struct {
+		const char *name;
+		int kind;
+		double param;
+	} derivetab[] = {
+		{ "rate", GRAPH_DERIVE_RATE, 0.0 },
+		{ "delta", GRAPH_DERIVE_DELTA, 0.0 },
+		{ "avg", GRAPH_DERIVE_AVG, 10.0 },
+		{ "ewma", GRAPH_DERIVE_EWMA, 0.1 }
+	};
+	struct derivation *d;
+	unsigned long win;
+	const char *kind;
+	char *end;
+	size_t i, len;
+
+	if (nderivations == (int) ARRLEN(derivations))
+		errx(1, "too many derived series");
+	d = &derivations[nderivations++];
+	d->keep = keep;
+
+	errno = 0;
+	d->column = strtoul(s, &end, 10);
+	if (errno != 0 || end == s || *end != ':' ||
+	    d->column >= GRAPH_MAX_SERIES)
+		errx(1, "%s: invalid value '%s'", opt, s);
+
+	kind = end + 1;
+	len = strcspn(kind, ":");
+	for (i = 0; i < ARRLEN(derivetab); i++)
+		if (strlen(derivetab[i].name) == len &&
+		    strncmp(kind, derivetab[i].name, len) == 0)
+			break;
+	if (i == ARRLEN(derivetab))
+		errx(1, "%s: invalid value '%s'", opt, s);
+	d->kind = derivetab[i].kind;
+	d->param = derivetab[i].param;
+
+	if (kind[len] == ':') {
+		if (d->kind != GRAPH_DERIVE_AVG && d->kind != GRAPH_DERIVE_EWMA)
+			errx(1, "%s: invalid value '%s'", opt, s);
+		errno = 0;
+		if (d->kind == GRAPH_DERIVE_AVG) {
+			win = strtoul(kind + len + 1, &end, 10);
+			if (errno != 0 || win < 1 || win > GRAPH_MAX_WINDOW)
+				errx(1, "%s: invalid value '%s'", opt, s);
+			d->param = win;
+		} else
+			d->param = strtod(kind + len + 1, &end);
+		if (errno != 0 || end == kind + len + 1 || *end != '\0' ||
+		    !isfinite(d->param))
+			errx(1, "%s: invalid value '%s'", opt, s);
+	}
+}
+
+/*
+ * parse_args: handle our own options, leaving the standard X11
+ * options in place for gfxctx_open().
+ */
+static void
+parse_args(int *argc, char **argv)
+{
+	int i, j;
+
+	for (i = j = 1; i < *argc; i++) {
+		if (strcmp(argv[i], "-fps") == 0 && i + 1 < *argc) {
+			fps = numarg(argv[i], argv[i + 1], 0, 1000);
+			i++;
+		} else if (strcmp(argv[i], "-history") == 0 &&
+		    i + 1 < *argc) {
+			history = numarg(argv[i], argv[i + 1], 1, 100000000);
+			i++;
+		} else if (strcmp(argv[i], "-format") == 0 && i + 1 < *argc) {
+			format = formatarg(argv[i], argv[i + 1]);
+			i++;
+		} else if (strcmp(argv[i], "-timestamps") == 0) {
+			timestamps = true;
+		} else if (strcmp(argv[i], "-reduce") == 0 && i + 1 < *argc) {
+			reduce = reducearg(argv[i], argv[i + 1]);
+			i++;
+		} else if (strcmp(argv[i], "-shm") == 0 && i + 1 < *argc) {
+			shmname = argv[i + 1];
+			i++;
+		} else if (strcmp(argv[i], "-thread") == 0) {
+			threaded = true;
+		} else if (strcmp(argv[i], "-stats") == 0 && i + 1 < *argc) {
+			statspath = argv[i + 1];
+			i++;
+		} else if (strcmp(argv[i], "-trace") == 0 && i + 1 < *argc) {
+			tracepath = argv[i + 1];
+			i++;
+		} else if (strcmp(argv[i], "-ttff") == 0) {
+			ttff = true;
+		} else if (strcmp(argv[i], "-socket") == 0 && i + 1 < *argc) {
+			socketpath = argv[i + 1];
+			i++;
+		} else if (strcmp(argv[i], "-grid") == 0 && i + 1 < *argc) {
+			gridarg(argv[i], argv[i + 1]);
+			i++;
+		} else if (strcmp(argv[i], "-src") == 0 && i + 1 < *argc) {
+			if (nsrcs == (int) ARRLEN(srcspecs))
+				errx(1, "too many sources");
+			srcspecs[nsrcs++] = argv[i + 1];
+			i++;
+		} else if (strcmp(argv[i], "-interval") == 0 &&
+		    i + 1 < *argc) {
+			interval = numarg(argv[i], argv[i + 1], 10, 3600000) *
+			    INT64_C(1000000);
+			i++;
+		} else if (strcmp(argv[i], "-derive") == 0 && i + 1 < *argc) {
+			derivearg(argv[i], argv[i + 1], true);
+			i++;
+		} else if (strcmp(argv[i], "-transform") == 0 &&
+		    i + 1 < *argc) {
+			derivearg(argv[i], argv[i + 1], false);
+			i++;
+		} else if (strcmp(argv[i], "-input") == 0 && i + 1 < *argc) {
+			if (ninputs == (int) ARRLEN(inputs))
+				errx(1, "too many inputs");
+			inputs[ninputs++] = argv[i + 1];
+			i++;
+		} else
+			argv[j++] = argv[i];
+	}
+	argv[j] = NULL;
+	*argc = j;
+
+	if (timestamps && format != FORMAT_TEXT)
+		errx(1, "-timestamps is only for text input");
+	if (grid_cols > 0 && (threaded || shmname != NULL))
+		errx(1, "-grid is not for -thread or -shm");
+	if (ninputs > 1 && grid_cols == 0)
+		errx(1, "more than one -input needs -grid");
+	if (ninputs > 0 && nsrcs > 0 && grid_cols == 0)
+		errx(1, "-input with -src needs -grid");
+}
+
+static int64_t
+now_ns(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) == -1)
+		err(1, "clock_gettime");
+
+	return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*
+ * read_data: read once and add what was read, all at the time of the
+ * read unless the input has times of its own. Returns the number of
+ * bytes read, 0 at end of input or -1 if a producer fails.
+ */
+static ssize_t
+read_data(struct client *c)
+{
+	int64_t t0;
+	ssize_t n;
+
+	t0 = TRACE_BEGIN();
+	n = ingest_fill(c->in);
+	TRACE_END("read", t0);
+	if (n == -1) {
+		if (c->series < 0 && c->panel < 0)
+			err(1, "read");
+		warn("read");
+		return -1;
+	}
+
+	t0 = TRACE_BEGIN();
+	if (format == FORMAT_TEXT)
+		add_lines(c->graph, c, timestamp());
+	else
+		add_records(c->graph, c, timestamp());
+	TRACE_END("parse", t0);
+
+	return n;
+}
+
+/*
+ * add_lines: add every complete line as a row, or with -timestamps
+ * each line at its own time. A producer feeds only the first value
+ * of a line to its series.
+ */
+static void
+add_lines(struct graph *graph, struct client *c, int64_t t)
+{
+	double row[GRAPH_MAX_SERIES];
+	const char *p;
+	size_t nrow, len, nlines;
+	char *line;
+
+	for (nlines = 0; (line = ingest_line(c->in, &len)) != NULL;
+	    nlines++) {
+		if (len == 0)
+			continue;
+		p = line;
+		if (timestamps && (p = timeparse(line, line + len, &t)) == NULL)
+			nrow = 0;
+		else
+			nrow = parse_row(p, line + len, row);
+		if (nrow == 0)
+			malformed(line);
+		else if (c->series < 0)
+			add(graph, t, -1, row, nrow);
+		else
+			add(graph, t, c->series, row, 1);
+	}
+	STATS_ADD_SHARED(lines, nlines);
+}
+
+/*
+ * add_records: add complete little-endian binary records. Doubles are
+ * added straight from the read buffer, floats are converted first.
+ */
+static void
+add_records(struct graph *graph, struct client *c, int64_t t)
+{
+	static double v[INGEST_BUFSZ / sizeof(float)];
+	struct tsrecord *ts;
+	size_t i, n;
+	int series;
+	double *d;
+	float *f;
+
+	series = (c->series < 0) ? 0 : c->series;
+	n = 0;
+	switch (format) {
+	case FORMAT_F32:
+		if ((f = ingest_records(c->in, sizeof(float), &n)) == NULL)
+			break;
+		swap_le(f, sizeof(float), n);
+		for (i = 0; i < n; i++)
+			v[i] = f[i];
+		add(graph, t, series, v, n);
+		break;
+	case FORMAT_F64:
+		if ((d = ingest_records(c->in, sizeof(double), &n)) == NULL)
+			break;
+		swap_le(d, sizeof(double), n);
+		add(graph, t, series, d, n);
+		break;
+	case FORMAT_TS64F64:
+		if ((ts = ingest_records(c->in, sizeof(struct tsrecord), &n)) ==
+		    NULL)
+			break;
+		swap_le(ts, sizeof(int64_t), 2 * n);
+		for (i = 0; i < n; i++)
+			add(graph, ts[i].time, series, &ts[i].value, 1);
+		break;
+	}
+	if (n > 0)
+		STATS_ADD_SHARED(lines, n);
+}
+
+/*
+ * add: add n values at t, a row of series from 0 on if series is -1
+ * or otherwise values of the series one after the other. With -thread
+ * the values are queued instead, waiting for the drawing thread if
+ * the queue is full.
+ */
+static void
+add(struct graph *graph, int64_t t, int series, const double *v, size_t n)
+{
+	struct queue_entry e[GRAPH_MAX_SERIES];
+	struct timespec ts;
+	size_t i, j, m;
+
+	if (queue == NULL) {
+		if (series < 0)
+			graph_add_row(graph, t, v, n);
+		else
+			graph_add_values(graph, t, series, v, n);
+		return;
+	}
+
+	/*
+	 * A row is pushed at once so that it is never drained in
+	 * part.
+	 */
+	for (i = 0; i < n; i += m) {
+		m = MIN(n - i, ARRLEN(e));
+		for (j = 0; j < m; j++) {
+			e[j].time = t;
+			e[j].series = series;
+			e[j].n = (series < 0 && j == 0) ? m : 1;
+			e[j].value = v[i + j];
+		}
+		while (!queue_push(queue, e, m)) {
+			wake();
+			ts.tv_sec = 0;
+			ts.tv_nsec = 1000000;
+			nanosleep(&ts, NULL);
+		}
+	}
+}
+
+/*
+ * drain_queue: add values queued by the ingest thread, at most
+ * MAX_QUEUE_ENTRIES per frame. Returns true if more were left.
+ */
+static bool
+drain_queue(struct graph *graph)
+{
+	static struct queue_entry e[4096];
+	static double row[GRAPH_MAX_SERIES];
+	static int64_t rowtime;
+	static size_t nrow, rowlen;
+	size_t i, n, total;
+
+	STATS_SET(queued, queue_length(queue));
+	for (total = 0; total < MAX_QUEUE_ENTRIES; total += n) {
+		if ((n = queue_pop(queue, e, ARRLEN(e))) == 0)
+			break;
+		for (i = 0; i < n; i++) {
+			if (e[i].series >= 0) {
+				graph_add_value(graph, e[i].time,
+				    e[i].series, e[i].value);
 				continue;
-			if (FD_ISSET(graph.clients[i].fd, &readfds)) {
-				if ((n = read(graph.clients[i].fd, buf,
-				    sizeof(buf) - 1)) <= 0)
-					graph.clients[i].fd = -1;
-				else {
-					composite = graph.clients[i].composite;
-					read_data(&graph, buf, n, composite);
-					gfxctx_flush(ctx);
-				}
+			}
+			if (nrow == 0) {
+				rowtime = e[i].time;
+				rowlen = e[i].n;
+			}
+			row[nrow++] = e[i].value;
+			if (nrow == rowlen) {
+				graph_add_row(graph, rowtime, row, nrow);
+				nrow = 0;
 			}
 		}
-#endif
-		if (socketpath == NULL && FD_ISSET(STDIN_FILENO, &readfds)) {
-			n = read(STDIN_FILENO, buf, sizeof(buf) - 1);
-			if (n <= 0)
-				err(1, "read");
-			read_data(graph, buf, n, 0);
-			gfxctx_flush(ctx);
-		} else if (FD_ISSET(gfxfd, &readfds)) {
-			gfxwin_process_events(ctx);
+	}
+
+	return total >= MAX_QUEUE_ENTRIES;
+}
+
+/*
+ * swap_le: convert n little-endian values of size bytes to host byte
+ * order in place, which is nothing to do on little-endian hosts.
+ */
+static void
+swap_le(void *p, size_t size, size_t n)
+{
+	static const uint16_t one = 1;
+	unsigned char *b, tmp;
+	size_t i, j;
+
+	if (*(const unsigned char *) &one == 1)
+		return;
+
+	for (b = p; n > 0; n--, b += size)
+		for (i = 0, j = size - 1; i < j; i++, j--) {
+			tmp = b[i];
+			b[i] = b[j];
+			b[j] = tmp;
 		}
+}
+
+/*
+ * read_shm: add records from the shared memory ring, stamping those
+ * without a time with the time of the read. Warns when the producer
+ * starts dropping records and then when the count doubles.
+ */
+static void
+read_shm(struct graph *graph, struct xrtshm *shm)
+{
+	static struct xrtshm_record rec[4096];
+	static uint64_t warn_dropped = 1;
+	size_t i, n, total;
+	uint64_t dropped;
+	int64_t t;
+
+	t = timestamp();
+	for (total = 0; total < MAX_SHM_RECORDS; total += n) {
+		if ((n = xrtshm_get(shm, rec, ARRLEN(rec))) == 0)
+			break;
+		for (i = 0; i < n; i++)
+			if (rec[i].series < GRAPH_MAX_SERIES)
+				graph_add_value(graph, (rec[i].time != 0) ?
+				    rec[i].time : t, rec[i].series,
+				    rec[i].value);
+	}
+	STATS_ADD_SHARED(lines, total);
+
+	dropped = xrtshm_dropped(shm);
+	STATS_SET(dropped, dropped);
+	if (dropped >= warn_dropped) {
+		warnx("%llu records dropped, ring full",
+		    (unsigned long long) dropped);
+		warn_dropped = dropped * 2;
 	}
 }
 
+/*
+ * read_sources: add a sample of each -src source as one row, a source
+ * that could not be read repeating its previous value, or with -grid
+ * each to its panel. Added straight to the graph also with -thread,
+ * as this is the drawing thread.
+ */
 static void
-read_data(struct graph *graph, char *buf, size_t n, int composite)
+read_sources(void)
 {
+	double row[GRAPH_MAX_SERIES];
+	int64_t t, mono;
 	double v;
-	time_t t;
+	int i;
 
-	if (n > 0)
-		buf[n] = '\0';
-	buf[strcspn(buf, "\r\n")] = '\0';
+	t = timestamp();
+	mono = now_ns();
+	for (i = 0; i < nsrcs; i++) {
+		if (!procsrc_read(srcs[i], mono, &v))
+			v = NAN;
+		if (grid_cols > 0) {
+			if (isfinite(v))
+				graph_add_value(graphs[ninputs + i], t, 0, v);
+		} else
+			row[i] = v;
+	}
+	if (grid_cols == 0)
+		graph_add_row(graphs[0], t, row, nsrcs);
+}
+
+/*
+ * parse_row: parse values separated by blanks or a comma. Returns the
+ * number of values, or 0 if the line is malformed. Values past
+ * GRAPH_MAX_SERIES are ignored.
+ */
+static size_t
+parse_row(const char *p, const char *end, double *row)
+{
+	size_t n;
 
-	v = atof(buf);
-	t = time(NULL);
+	for (n = 0; n < GRAPH_MAX_SERIES; n++) {
+		while (p < end && (*p == ' ' || *p == '\t'))
+			p++;
+		if (p == end)
+			break;
+		if ((p = numparse(p, end, &row[n])) == NULL)
+			return 0;
+		while (p < end && (*p == ' ' || *p == '\t'))
+			p++;
+		if (p < end && *p == ',')
+			p++;
+	}
 
-	graph_add_data(graph, t, v);
+	return n;
+}
+
+/*
+ * malformed: count malformed lines, warn on the first and then on
+ * every power of two so that garbage input does not flood stderr.
+ */
+static void
+malformed(const char *line)
+{
+	static unsigned long nmalformed;
+
+	nmalformed++;
+	STATS_ADD(malformed, 1);
+	if (nmalformed == 1)
+		warnx("ignoring malformed input: '%s'", line);
+	else if ((nmalformed & (nmalformed - 1)) == 0)
+		warnx("%lu malformed lines ignored", nmalformed);
 }
 
 #if 0
@@ -215,3 +1305,23 @@ make_small(double val, char *unit)
 	return smallv;	
 }
 #endif
+
+/*
+ * timestamp: wall clock time in nanoseconds since the Epoch, advanced
+ * by the monotonic clock so that it does not jump with the wall clock.
+ */
+static int64_t
+timestamp(void)
+{
+	static int64_t base_real, base_mono;
+	struct timespec ts;
+
+	if (base_mono == 0) {
+		if (clock_gettime(CLOCK_REALTIME, &ts) == -1)
+			err(1, "clock_gettime");
+		base_real = (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+		base_mono = now_ns();
+	}
+
+	return base_real + (now_ns() - base_mono);
+}
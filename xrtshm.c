@@ -0,0 +1,194 @@
+/*
+ * Single-producer single-consumer ring of records in POSIX shared
+ * memory, see xrtshm.h.
+ */
+
+#include "xrtshm.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+struct xrtshm
+{
+	struct xrtshm_ring *ring;
+	size_t mapsz;
+	uint64_t mask;
+	char *name;		/* Unlinked on destroy by the producer */
+};
+
+static struct xrtshm *map(int, size_t, const char *);
+
+/*
+ * xrtshm_create: create ring of at least n records, replacing a ring
+ * left behind by a previous run. Returns NULL with errno set on
+ * failure.
+ */
+struct xrtshm*
+xrtshm_create(const char *name, size_t n)
+{
+	struct xrtshm *shm;
+	size_t size, mapsz;
+	int fd;
+
+	for (size = 1; size < n; size *= 2)
+		;
+	mapsz = sizeof(struct xrtshm_ring) +
+	    size * sizeof(struct xrtshm_record);
+
+	shm_unlink(name);
+	if ((fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600)) == -1)
+		return NULL;
+	if (ftruncate(fd, mapsz) == -1 ||
+	    (shm = map(fd, mapsz, name)) == NULL) {
+		close(fd);
+		shm_unlink(name);
+		return NULL;
+	}
+	close(fd);
+
+	shm->ring->size = size;
+	shm->ring->version = XRTSHM_VERSION;
+	shm->mask = size - 1;
+
+	/*
+	 * Magic last: the ring is ready once it is seen.
+	 */
+	__atomic_store_n(&shm->ring->magic, XRTSHM_MAGIC, __ATOMIC_RELEASE);
+	return shm;
+}
+
+/*
+ * xrtshm_put: add record, or drop it if the ring is full. Time is
+ * nanoseconds since the Epoch or 0 for the time it is read. Returns 0
+ * on success and -1 if dropped.
+ */
+int
+xrtshm_put(struct xrtshm *shm, int64_t time, uint32_t series, double value)
+{
+	struct xrtshm_ring *r = shm->ring;
+	struct xrtshm_record *rec;
+	uint64_t head;
+
+	head = r->head;
+	if (head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) > shm->mask) {
+		__atomic_store_n(&r->dropped, r->dropped + 1,
+		    __ATOMIC_RELAXED);
+		return -1;
+	}
+
+	rec = &r->record[head & shm->mask];
+	rec->time = time;
+	rec->series = series;
+	rec->value = value;
+	__atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+void
+xrtshm_destroy(struct xrtshm *shm)
+{
+	if (shm->name != NULL)
+		shm_unlink(shm->name);
+	munmap(shm->ring, shm->mapsz);
+	free(shm->name);
+	free(shm);
+}
+
+/*
+ * xrtshm_attach: attach to ring created by the producer. Returns NULL
+ * with errno set on failure.
+ */
+struct xrtshm*
+xrtshm_attach(const char *name)
+{
+	struct xrtshm *shm;
+	struct xrtshm_ring *r;
+	struct stat st;
+	int fd;
+
+	if ((fd = shm_open(name, O_RDWR, 0)) == -1)
+		return NULL;
+	if (fstat(fd, &st) == -1) {
+		close(fd);
+		return NULL;
+	}
+	if ((size_t) st.st_size < sizeof(struct xrtshm_ring)) {
+		close(fd);
+		errno = EINVAL;
+		return NULL;
+	}
+	shm = map(fd, st.st_size, NULL);
+	close(fd);
+	if (shm == NULL)
+		return NULL;
+
+	r = shm->ring;
+	if (__atomic_load_n(&r->magic, __ATOMIC_ACQUIRE) != XRTSHM_MAGIC ||
+	    r->version != XRTSHM_VERSION || r->size == 0 ||
+	    (r->size & (r->size - 1)) != 0 ||
+	    r->size > (shm->mapsz - sizeof(struct xrtshm_ring)) /
+	    sizeof(struct xrtshm_record)) {
+		xrtshm_destroy(shm);
+		errno = EINVAL;
+		return NULL;
+	}
+	shm->mask = r->size - 1;
+	return shm;
+}
+
+/*
+ * xrtshm_get: take at most n records from the ring. Returns the number
+ * of records taken.
+ */
+size_t
+xrtshm_get(struct xrtshm *shm, struct xrtshm_record *rec, size_t n)
+{
+	struct xrtshm_ring *r = shm->ring;
+	uint64_t head, tail, i;
+
+	tail = r->tail;
+	head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+	if (head - tail < n)
+		n = head - tail;
+
+	for (i = 0; i < n; i++)
+		rec[i] = r->record[(tail + i) & shm->mask];
+
+	__atomic_store_n(&r->tail, tail + n, __ATOMIC_RELEASE);
+	return n;
+}
+
+uint64_t
+xrtshm_dropped(struct xrtshm *shm)
+{
+	return __atomic_load_n(&shm->ring->dropped, __ATOMIC_RELAXED);
+}
+
+static struct xrtshm *
+map(int fd, size_t mapsz, const char *name)
+{
+	struct xrtshm *shm;
+	void *p;
+
+	if ((shm = calloc(1, sizeof(struct xrtshm))) == NULL)
+		return NULL;
+	if (name != NULL && (shm->name = strdup(name)) == NULL) {
+		free(shm);
+		return NULL;
+	}
+
+	p = mmap(NULL, mapsz, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (p == MAP_FAILED) {
+		free(shm->name);
+		free(shm);
+		return NULL;
+	}
+	shm->ring = p;
+	shm->mapsz = mapsz;
+	return shm;
+}
@@ -0,0 +1,70 @@
+/*
+ * xrtshm - feed xrtgraph from within a program through shared memory
+ *
+ * The producer creates a ring of (time, series, value) records in POSIX
+ * shared memory and xrtgraph -shm <name> drains it once per frame.
+ * There is one producer and one consumer. Adding a record is a few
+ * stores and an atomic index bump, never a system call, and when the
+ * ring is full the record is dropped and counted instead of waiting.
+ *
+ *	struct xrtshm *shm;
+ *
+ *	if ((shm = xrtshm_create("/myservice", 65536)) == NULL)
+ *		err(1, "xrtshm_create");
+ *	for (;;)
+ *		xrtshm_put(shm, 0, 0, measure());
+ */
+
+#ifndef XRTSHM_H
+#define XRTSHM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define XRTSHM_MAGIC	0x78727473	/* "xrts" */
+#define XRTSHM_VERSION	1
+
+struct xrtshm_record
+{
+	int64_t time;		/* Nanoseconds since the Epoch, 0 for now */
+	uint32_t series;
+	uint32_t pad;
+	double value;
+};
+
+/*
+ * Layout of the shared memory. The indices count records from the
+ * start and are on cache lines of their own, as the producer writes
+ * only 'head' and the consumer only 'tail'.
+ */
+struct xrtshm_ring
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t size;		/* Number of records, a power of two */
+	char pad1[48];
+	uint64_t head;		/* Next record to write */
+	uint64_t dropped;	/* Records dropped when full */
+	char pad2[48];
+	uint64_t tail;		/* Next record to read */
+	char pad3[56];
+	struct xrtshm_record record[];
+};
+
+struct xrtshm;
+
+/*
+ * Producer.
+ */
+struct xrtshm* xrtshm_create(const char *, size_t);
+int xrtshm_put(struct xrtshm *, int64_t, uint32_t, double);
+void xrtshm_destroy(struct xrtshm *);
+
+/*
+ * Consumer.
+ */
+struct xrtshm* xrtshm_attach(const char *);
+size_t xrtshm_get(struct xrtshm *, struct xrtshm_record *, size_t);
+uint64_t xrtshm_dropped(struct xrtshm *);
+
+#endif